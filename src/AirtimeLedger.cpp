@@ -0,0 +1,129 @@
+#include <AirtimeLedger.hpp>
+
+/*
+ * LoRaWAN framing around the application payload: MHDR (1), DevAddr (4), FCtrl (1),
+ * FCnt (2), FPort (1) and MIC (4). Piggybacked MAC commands are not included.
+ */
+static const uint8_t LORAWAN_OVERHEAD = 13;
+static const uint8_t PREAMBLE_SYMBOLS = 8;
+
+uint32_t timeOnAirUs(uint8_t sf, uint16_t bwKhz, uint8_t cr, uint8_t phyLen, bool crc, bool implicitHeader)
+{
+    uint32_t symbolUs = ((uint32_t)1 << sf) * 1000 / bwKhz;
+
+    // Low data rate optimisation is required once a symbol is 16 ms or longer
+    int lowDr = symbolUs >= 16000 ? 1 : 0;
+
+    int num = 8 * phyLen - 4 * sf + 28 + (crc ? 16 : 0) - (implicitHeader ? 20 : 0);
+    int den = 4 * (sf - 2 * lowDr);
+    int payloadSymbols = 8;
+    if (num > 0)
+    {
+        payloadSymbols += ((num + den - 1) / den) * (cr + 4);
+    }
+
+    // Preamble is the programmed length plus 4.25 symbols
+    uint32_t preambleUs = (PREAMBLE_SYMBOLS * 4 + 17) * symbolUs / 4;
+    return preambleUs + payloadSymbols * symbolUs;
+}
+
+uint32_t uplinkTimeOnAirUs(uint8_t dr, uint8_t appLen)
+{
+    // US915 uplinks: DR0 - DR3 are SF10 - SF7 at 125 kHz, DR4 is SF8 at 500 kHz
+    uint8_t sf = dr < 4 ? 10 - dr : 8;
+    uint16_t bw = dr < 4 ? 125 : 500;
+    return timeOnAirUs(sf, bw, 1, appLen + LORAWAN_OVERHEAD, true, false);
+}
+
+AirtimeLedger::AirtimeLedger(uint32_t hourBudgetMs, uint32_t dayBudgetMs)
+    : hourBudget(hourBudgetMs), dayBudget(dayBudgetMs), lastEpoch(0), hourSlot(0), daySlot(0), lifetimeMs(0)
+{
+    memset(hourBucket, 0, sizeof(hourBucket));
+    memset(dayBucket, 0, sizeof(dayBucket));
+}
+
+void AirtimeLedger::setBudget(uint32_t hourBudgetMs, uint32_t dayBudgetMs)
+{
+    hourBudget = hourBudgetMs;
+    dayBudget = dayBudgetMs;
+}
+
+void AirtimeLedger::advance(uint32_t epoch)
+{
+    uint32_t newHourSlot = epoch / 300;
+    uint32_t newDaySlot = epoch / 3600;
+
+    // The RTC is stepped when the network time arrives, keep the totals across the jump
+    if (epoch < lastEpoch || epoch - lastEpoch > 86400)
+    {
+        hourSlot = newHourSlot;
+        daySlot = newDaySlot;
+    }
+    lastEpoch = epoch;
+
+    for (uint8_t i = 0; hourSlot < newHourSlot && i < HOUR_BUCKETS; ++i)
+    {
+        hourBucket[++hourSlot % HOUR_BUCKETS] = 0;
+    }
+    hourSlot = newHourSlot;
+
+    for (uint8_t i = 0; daySlot < newDaySlot && i < DAY_BUCKETS; ++i)
+    {
+        dayBucket[++daySlot % DAY_BUCKETS] = 0;
+    }
+    daySlot = newDaySlot;
+}
+
+void AirtimeLedger::add(uint32_t epoch, uint32_t airtimeUs)
+{
+    advance(epoch);
+
+    uint32_t ms = (airtimeUs + 999) / 1000;
+    hourBucket[hourSlot % HOUR_BUCKETS] += ms;
+    dayBucket[daySlot % DAY_BUCKETS] += ms;
+    lifetimeMs += ms;
+}
+
+BudgetDecision AirtimeLedger::check(uint32_t epoch, MsgPriority prio, uint32_t airtimeUs)
+{
+    if (prio == PRIORITY_CRITICAL)
+    {
+        return BUDGET_SEND;
+    }
+
+    uint32_t ms = (airtimeUs + 999) / 1000;
+    uint32_t hour = hourMs(epoch) + ms;
+    uint32_t day = dayMs(epoch) + ms;
+
+    if (prio == PRIORITY_LOW)
+    {
+        bool fits = hour * 100 <= hourBudget * LOW_PRIORITY_SHARE && day * 100 <= dayBudget * LOW_PRIORITY_SHARE;
+        return fits ? BUDGET_SEND : BUDGET_DROP;
+    }
+
+    return hour <= hourBudget && day <= dayBudget ? BUDGET_SEND : BUDGET_DEFER;
+}
+
+uint32_t AirtimeLedger::hourMs(uint32_t epoch)
+{
+    advance(epoch);
+
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < HOUR_BUCKETS; ++i)
+    {
+        sum += hourBucket[i];
+    }
+    return sum;
+}
+
+uint32_t AirtimeLedger::dayMs(uint32_t epoch)
+{
+    advance(epoch);
+
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < DAY_BUCKETS; ++i)
+    {
+        sum += dayBucket[i];
+    }
+    return sum;
+}
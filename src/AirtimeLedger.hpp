@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * LoRa time on air in microseconds, Semtech SX1276 datasheet 4.1.1.7
+ *   sf - spreading factor 7 - 12
+ *   bwKhz - bandwidth, 125, 250 or 500
+ *   cr - coding rate 1 - 4, i.e. 4/5 - 4/8
+ *   phyLen - PHY payload length, including the LoRaWAN header and MIC
+ */
+uint32_t timeOnAirUs(uint8_t sf, uint16_t bwKhz, uint8_t cr, uint8_t phyLen, bool crc, bool implicitHeader);
+
+/*
+ * Time on air of a US915 data uplink with appLen bytes of application payload at dr
+ */
+uint32_t uplinkTimeOnAirUs(uint8_t dr, uint8_t appLen);
+
+enum MsgPriority
+{
+    PRIORITY_LOW,     // Dropped when over budget, e.g. the periodic heartbeat that is resent anyway
+    PRIORITY_NORMAL,  // Deferred until the budget allows it
+    PRIORITY_CRITICAL // Always sent, LMIC still applies the regulatory duty cycle
+};
+
+enum BudgetDecision
+{
+    BUDGET_SEND,
+    BUDGET_DEFER,
+    BUDGET_DROP
+};
+
+/*
+ * Rolling account of the airtime used by this node, kept against a network fair use budget.
+ * The last hour is tracked in 5 minute buckets and the last day in hourly buckets.
+ */
+class AirtimeLedger
+{
+public:
+    static const uint8_t LOW_PRIORITY_SHARE = 75; // Percent of the budget low priority traffic may use
+
+    AirtimeLedger(uint32_t hourBudgetMs, uint32_t dayBudgetMs);
+
+    // Change the budget, the airtime already used still counts against it
+    void setBudget(uint32_t hourBudgetMs, uint32_t dayBudgetMs);
+
+    // Record a transmission that has started
+    void add(uint32_t epoch, uint32_t airtimeUs);
+
+    // Can a frame with this airtime be sent now
+    BudgetDecision check(uint32_t epoch, MsgPriority prio, uint32_t airtimeUs);
+
+    uint32_t hourMs(uint32_t epoch);
+    uint32_t dayMs(uint32_t epoch);
+    uint32_t totalMs() const { return lifetimeMs; }
+
+private:
+    static const uint8_t HOUR_BUCKETS = 12;
+    static const uint8_t DAY_BUCKETS = 24;
+
+    void advance(uint32_t epoch);
+
+    uint32_t hourBudget;
+    uint32_t dayBudget;
+    uint32_t hourBucket[HOUR_BUCKETS];
+    uint32_t dayBucket[DAY_BUCKETS];
+    uint32_t lastEpoch;
+    uint32_t hourSlot; // Current 5 minute slot, epoch / 300
+    uint32_t daySlot;  // Current hour slot, epoch / 3600
+    uint32_t lifetimeMs;
+};
@@ -0,0 +1,17 @@
+#include <BootTimer.hpp>
+
+BootTimer::BootTimer()
+{
+    for (uint8_t i = 0; i < BOOT_PHASES; ++i)
+    {
+        phaseMs[i] = NOT_REACHED;
+    }
+}
+
+void BootTimer::mark(BootPhase phase, uint32_t nowMs)
+{
+    if (!reached(phase))
+    {
+        phaseMs[phase] = nowMs;
+    }
+}
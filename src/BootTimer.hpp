@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Boot phases, in the order they are normally reached
+ */
+enum BootPhase
+{
+    BOOT_CLOCK,      // Core clocks up, entry to setup()
+    BOOT_RTC,        // RTC started
+    BOOT_FLASH,      // Config and schedule cache read from flash
+    BOOT_OS_INIT,    // LMIC initialised
+    BOOT_JOIN_START, // First join request
+    BOOT_JOINED,     // Joined, or session restored from flash
+    BOOT_TIME_SYNC,  // RTC first set from the network
+    BOOT_SCHEDULE,   // First schedule applied
+    BOOT_PHASES
+};
+
+/*
+ * Time from power on (millis()) at which each boot phase was first reached
+ */
+class BootTimer
+{
+public:
+    BootTimer();
+
+    // Record the phase, only the first time it is reached counts
+    void mark(BootPhase phase, uint32_t nowMs);
+
+    bool reached(BootPhase phase) const { return phaseMs[phase] != NOT_REACHED; }
+
+    // ms from power on, 0 when the phase was not reached
+    uint32_t ms(BootPhase phase) const { return reached(phase) ? phaseMs[phase] : 0; }
+
+private:
+    static const uint32_t NOT_REACHED = 0xFFFFFFFF;
+
+    uint32_t phaseMs[BOOT_PHASES];
+};
@@ -0,0 +1,44 @@
+#include <CommandTable.hpp>
+
+CommandStatus runCommand(const CommandDef *table, CommandSeq *seqs, uint8_t count, const DownlinkView &dl,
+                         uint8_t &opcode, uint8_t &seq, CommandReply &reply)
+{
+    reply.len = 0;
+    opcode = dl.len > 0 ? dl.data[0] : 0;
+    seq = dl.len > 1 ? dl.data[1] : 0;
+    if (dl.len < 2)
+    {
+        return CMD_BAD_LENGTH;
+    }
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        const CommandDef &def = table[i];
+        if (def.port != dl.port || def.opcode != opcode)
+        {
+            continue;
+        }
+
+        uint8_t argLen = dl.len - 2;
+        if (argLen < def.minLen || argLen > def.maxLen)
+        {
+            return CMD_BAD_LENGTH;
+        }
+        if (dl.multicast && (def.flags & CMD_GROUP) == 0)
+        {
+            return CMD_NOT_ALLOWED;
+        }
+
+        // Sequence numbers wrap, anything up to 127 behind the last one is a repeat
+        CommandSeq &last = seqs[i];
+        if (last.seen && (int8_t)(seq - last.last) <= 0)
+        {
+            return CMD_DUPLICATE;
+        }
+        last.last = seq;
+        last.seen = true;
+
+        return def.handler(dl.data + 2, argLen, reply);
+    }
+    return CMD_UNKNOWN;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Downlink.hpp>
+
+/*
+ * Binary downlink commands: [opcode][sequence][arguments], looked up by fport and opcode
+ * in a table that lives in flash. Every command is answered with a response uplink:
+ *
+ *   [opcode][sequence][status][reply data]
+ *
+ * The server numbers each command it sends per opcode. A command whose sequence is not
+ * newer than the last one run for that opcode is a repeat: it is answered, but not run.
+ *
+ * Commands flagged CMD_GROUP may also arrive on the multicast group session. Those are
+ * numbered by the server per group, so they are tracked in their own CommandSeq array,
+ * and are never answered: a whole fleet replying at once would jam the channel.
+ */
+enum CommandStatus
+{
+    CMD_OK = 0,
+    CMD_UNKNOWN = 1,     // No command for this port / opcode
+    CMD_BAD_LENGTH = 2,  // Arguments too short or too long for the command
+    CMD_BAD_VALUE = 3,   // Arguments out of range
+    CMD_FAILED = 4,      // Valid but could not be carried out
+    CMD_DUPLICATE = 5,   // Repeat of a command already run, not run again
+    CMD_NOT_ALLOWED = 6, // Command may not be sent to a multicast group
+    CMD_MISS = 7         // Refers to data the node does not hold, the server should send it
+};
+
+// CommandDef flags
+const uint8_t CMD_GROUP = 0x01; // Accepted on the multicast group session
+
+struct CommandReply
+{
+    static const uint8_t MAX_LEN = 16;
+
+    uint8_t len;
+    uint8_t data[MAX_LEN];
+};
+
+typedef CommandStatus (*CommandHandler)(const uint8_t *args, uint8_t len, CommandReply &reply);
+
+struct CommandDef
+{
+    uint8_t port;
+    uint8_t opcode;
+    uint8_t minLen; // Argument bytes, not counting the opcode
+    uint8_t maxLen;
+    uint8_t flags;
+    CommandHandler handler;
+};
+
+/*
+ * Last sequence number run for each entry of a command table. The caller keeps them
+ * over a reboot, or a replayed command is run again.
+ */
+struct CommandSeq
+{
+    uint8_t last;
+    bool seen;
+};
+
+/*
+ * Validate and run the command in a downlink, opcode and seq are set for the response.
+ * seqs has one entry per table entry.
+ */
+CommandStatus runCommand(const CommandDef *table, CommandSeq *seqs, uint8_t count, const DownlinkView &dl,
+                         uint8_t &opcode, uint8_t &seq, CommandReply &reply);
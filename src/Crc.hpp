@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * CRC-16/CCITT (poly 0x1021), chain calls by passing the previous result as crc
+ */
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
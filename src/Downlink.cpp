@@ -0,0 +1,59 @@
+#include <Downlink.hpp>
+
+bool dispatchDownlink(const DownlinkView &dl, const DownlinkRoute *routes, uint8_t routeCount)
+{
+    for (uint8_t i = 0; i < routeCount; ++i)
+    {
+        if (routes[i].port == dl.port)
+        {
+            routes[i].handler(dl);
+            return true;
+        }
+    }
+    return false;
+}
+
+DownlinkView InboundFrame::view() const
+{
+    DownlinkView dl;
+    dl.data = data;
+    dl.len = len;
+    dl.port = port;
+    dl.flags = flags;
+    dl.rssi = rssi;
+    dl.snr = snr;
+    dl.fcnt = fcnt;
+    dl.replay = replay;
+    dl.multicast = multicast;
+    return dl;
+}
+
+bool InboundQueue::push(const DownlinkView &dl)
+{
+    if (count == CAPACITY || dl.len > InboundFrame::MAX_LEN)
+    {
+        return false;
+    }
+
+    InboundFrame &frame = frames[(head + count) % CAPACITY];
+    memcpy(frame.data, dl.data, dl.len);
+    frame.len = dl.len;
+    frame.port = dl.port;
+    frame.flags = dl.flags;
+    frame.rssi = dl.rssi;
+    frame.snr = dl.snr;
+    frame.fcnt = dl.fcnt;
+    frame.replay = dl.replay;
+    frame.multicast = dl.multicast;
+    ++count;
+    return true;
+}
+
+void InboundQueue::pop()
+{
+    if (count > 0)
+    {
+        head = (head + 1) % CAPACITY;
+        --count;
+    }
+}
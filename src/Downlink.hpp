@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Non-owning view of a received downlink. data points into the LMIC frame buffer and
+ * is only valid until the radio is used again, handlers must not keep it.
+ */
+struct DownlinkView
+{
+    const uint8_t *data;
+    uint8_t len;
+    uint8_t port;
+    uint8_t flags; // LMIC txrxFlags
+    int16_t rssi;  // dBm
+    int8_t snr;    // dB * 4
+    uint32_t fcnt; // FCntDown of the frame
+    bool replay;   // Same FCntDown as the last frame, the network repeated a confirmed downlink
+    bool multicast; // Received on the multicast group session, not addressed to this node alone
+};
+
+typedef void (*DownlinkHandler)(const DownlinkView &dl);
+
+struct DownlinkRoute
+{
+    uint8_t port;
+    DownlinkHandler handler;
+};
+
+/*
+ * Copy of a received downlink, kept until it can be processed outside the radio callback
+ */
+struct InboundFrame
+{
+    static const uint8_t MAX_LEN = 242; // Largest US915 downlink payload
+
+    uint8_t len;
+    uint8_t port;
+    uint8_t flags;
+    int16_t rssi;
+    int8_t snr;
+    uint32_t fcnt;
+    bool replay;
+    bool multicast;
+    uint8_t data[MAX_LEN];
+
+    DownlinkView view() const;
+};
+
+/*
+ * Small FIFO of downlinks between the LMIC event callback and the job that handles them
+ */
+class InboundQueue
+{
+public:
+    static const uint8_t CAPACITY = 2;
+
+    InboundQueue() : head(0), count(0) {}
+
+    // Copy a downlink in, false if it is too long or the queue is full
+    bool push(const DownlinkView &dl);
+
+    // Oldest downlink, NULL when empty. Stays valid until pop()
+    const InboundFrame *front() const { return count > 0 ? &frames[head] : NULL; }
+    void pop();
+
+private:
+    InboundFrame frames[CAPACITY];
+    uint8_t head;
+    uint8_t count;
+};
+
+/*
+ * Hand a downlink to the handler registered for its port, false if there is none
+ */
+bool dispatchDownlink(const DownlinkView &dl, const DownlinkRoute *routes, uint8_t routeCount);
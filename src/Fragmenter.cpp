@@ -0,0 +1,61 @@
+#include <Fragmenter.hpp>
+
+Fragmenter::Fragmenter()
+    : length(0), chunk(0), seq(0), index(0), count(0)
+{
+}
+
+bool Fragmenter::load(const uint8_t *msg, size_t len, size_t budget)
+{
+    index = count = 0;
+    if (len > MAX_MESSAGE)
+    {
+        return false;
+    }
+
+    memcpy(message, msg, len);
+    length = len;
+    return split(budget);
+}
+
+bool Fragmenter::fit(size_t budget)
+{
+    if ((size_t)HEADER_LEN + chunk <= budget)
+    {
+        return true;
+    }
+    return split(budget);
+}
+
+bool Fragmenter::split(size_t budget)
+{
+    if (budget <= HEADER_LEN)
+    {
+        return false;
+    }
+
+    size_t room = budget - HEADER_LEN;
+    uint8_t size = room > 0xFF ? 0xFF : room;
+    size_t needed = (length + size - 1) / size;
+    if (needed == 0 || needed > MAX_FRAGMENTS)
+    {
+        return false;
+    }
+
+    ++seq;
+    chunk = size;
+    index = 0;
+    count = needed;
+    return true;
+}
+
+size_t Fragmenter::next(uint8_t *buf) const
+{
+    size_t offset = (size_t)index * chunk;
+    size_t len = length - offset < chunk ? length - offset : chunk;
+
+    buf[0] = seq;
+    buf[1] = (index << 4) | (count - 1);
+    memcpy(buf + HEADER_LEN, message + offset, len);
+    return HEADER_LEN + len;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Splits a message that does not fit the current data rate across several uplinks.
+ * Each fragment carries a two byte header so the server can put it back together:
+ *
+ *   [message sequence][fragment index << 4 | (fragment count - 1)][message bytes]...
+ *
+ * If the data rate drops while a message is being sent, the remaining frames would no
+ * longer fit, so the message is split again from the start under a new sequence number.
+ * When that would take too many fragments the message is kept as it was, to go on once
+ * the data rate allows.
+ */
+class Fragmenter
+{
+public:
+    static const uint8_t HEADER_LEN = 2;
+    static const uint8_t MAX_FRAGMENTS = 16;
+    static const uint16_t MAX_MESSAGE = 256;
+
+    Fragmenter();
+
+    // Copy and split a message for frames of at most budget bytes, false if it needs too many
+    bool load(const uint8_t *msg, size_t len, size_t budget);
+
+    // Make sure the next fragment fits in budget bytes, splitting again if needed. False,
+    // with the message and position unchanged, if it cannot be split that small
+    bool fit(size_t budget);
+
+    bool pending() const { return index < count; }
+    uint8_t fragmentIndex() const { return index; }
+    uint8_t fragmentCount() const { return count; }
+
+    // Write the next fragment into buf, returns the frame length
+    size_t next(uint8_t *buf) const;
+
+    // The fragment returned by next() was handed to the radio
+    void commit() { ++index; }
+
+    // Abandon the rest of the message
+    void clear() { index = count = 0; }
+
+private:
+    bool split(size_t budget);
+
+    uint8_t message[MAX_MESSAGE];
+    uint16_t length;
+    uint8_t chunk;
+    uint8_t seq;
+    uint8_t index;
+    uint8_t count;
+};
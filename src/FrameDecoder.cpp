@@ -0,0 +1,86 @@
+#include <FrameDecoder.hpp>
+
+static const uint8_t MHDR_UNCONFIRMED_DOWN = 0x60;
+static const uint8_t MHDR_CONFIRMED_DOWN = 0xA0;
+static const uint8_t HEADER_LEN = 8; // MHDR, DevAddr, FCtrl, FCnt
+static const uint8_t MIC_LEN = 4;
+static const uint32_t MAX_FCNT_GAP = 16384;
+
+/*
+ * Same block construction as the LMIC MIC and cipher, on the LMIC AES engine
+ */
+static bool verifyMic(const uint8_t *key, uint32_t devAddr, uint32_t fcnt, uint8_t *pdu, uint8_t len)
+{
+    os_clearMem(AESaux, 16);
+    AESaux[0] = 0x49;
+    AESaux[5] = 1; // Downlink
+    AESaux[15] = len;
+    os_wlsbf4(AESaux + 6, devAddr);
+    os_wlsbf4(AESaux + 10, fcnt);
+    os_copyMem(AESkey, key, 16);
+    return os_aes(AES_MIC, pdu, len) == os_rmsbf4(pdu + len);
+}
+
+static void decrypt(const uint8_t *key, uint32_t devAddr, uint32_t fcnt, uint8_t *payload, uint8_t len)
+{
+    os_clearMem(AESaux, 16);
+    AESaux[0] = AESaux[15] = 1; // Cipher mode, block counter 1
+    AESaux[5] = 1;              // Downlink
+    os_wlsbf4(AESaux + 6, devAddr);
+    os_wlsbf4(AESaux + 10, fcnt);
+    os_copyMem(AESkey, key, 16);
+    os_aes(AES_CTR, payload, len);
+}
+
+bool decodeDownFrame(FrameSession &session, uint8_t *frame, uint8_t len, DownlinkView &dl)
+{
+    if (len < HEADER_LEN + 1 + MIC_LEN)
+    {
+        return false;
+    }
+
+    uint8_t mhdr = frame[0];
+    if (mhdr != MHDR_UNCONFIRMED_DOWN && mhdr != MHDR_CONFIRMED_DOWN)
+    {
+        return false;
+    }
+    if (os_rlsbf4(frame + 1) != session.devAddr)
+    {
+        return false;
+    }
+
+    uint8_t portPos = HEADER_LEN + (frame[5] & 0x0F);
+    if (portPos >= len - MIC_LEN || frame[portPos] == 0)
+    {
+        return false;
+    }
+
+    // Rebuild the 32 bit counter from the 16 bits on the air
+    uint32_t fcnt = (session.nextFCnt & 0xFFFF0000) | os_rlsbf2(frame + 6);
+    if (fcnt < session.nextFCnt)
+    {
+        fcnt += 0x10000;
+    }
+    if (fcnt - session.nextFCnt > MAX_FCNT_GAP)
+    {
+        return false;
+    }
+
+    uint8_t pduLen = len - MIC_LEN;
+    if (!verifyMic(session.nwkKey, session.devAddr, fcnt, frame, pduLen))
+    {
+        return false;
+    }
+
+    uint8_t dataPos = portPos + 1;
+    decrypt(session.appKey, session.devAddr, fcnt, frame + dataPos, pduLen - dataPos);
+    session.nextFCnt = fcnt + 1;
+
+    dl.data = frame + dataPos;
+    dl.len = pduLen - dataPos;
+    dl.port = frame[portPos];
+    dl.flags = 0;
+    dl.fcnt = fcnt;
+    dl.replay = false;
+    return true;
+}
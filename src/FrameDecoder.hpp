@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include <lmic.h>
+#include <Downlink.hpp>
+
+/*
+ * Session keys and frame counter for decoding downlinks outside of LMIC
+ */
+struct FrameSession
+{
+    uint32_t devAddr;
+    uint8_t nwkKey[16];
+    uint8_t appKey[16];
+    uint32_t nextFCnt; // Lowest FCntDown still accepted
+};
+
+/*
+ * Check and decrypt a raw LoRaWAN data downlink received by the radio outside of LMIC,
+ * for frames LMIC itself does not accept (e.g. multicast group addresses).
+ *
+ * The MIC is verified with the network key, the frame counter must be newer than
+ * the session's, and the FRMPayload is decrypted in place with the application key.
+ * On success dl points into frame and the session counter is advanced. Frames without
+ * a port, or for port 0 (MAC commands), are rejected.
+ */
+bool decodeDownFrame(FrameSession &session, uint8_t *frame, uint8_t len, DownlinkView &dl);
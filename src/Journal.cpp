@@ -0,0 +1,273 @@
+#include <Journal.hpp>
+#include <Crc.hpp>
+
+static const uint16_t JOURNAL_MAGIC = 0x4A4C;
+static const uint16_t NVM_ROW_SIZE = 256;
+static const uint16_t NVM_PAGE_SIZE = 64;
+static const uint8_t END_OF_ROW = 0xFF; // Erased flash in place of a record length
+
+__attribute__((__aligned__(NVM_ROW_SIZE))) static const uint8_t journalRows[Journal::ROWS * Journal::ROW_SIZE] = {};
+static FlashClass journalFlash(journalRows, sizeof(journalRows));
+
+// Layout of the start of each row, the magic is written last
+struct RowHeader
+{
+    uint32_t seq;
+    uint16_t unused;
+    uint16_t magic;
+};
+
+// Layout of each record, followed by len bytes of data padded to a word. The length is
+// written first, so a record torn by a power loss can still be stepped over.
+struct RecordHeader
+{
+    uint8_t len;
+    uint8_t type;
+    uint16_t crc; // CRC-16/CCITT of len, type and data
+};
+
+static const uint16_t MAX_RECORD = sizeof(RecordHeader) + Journal::MAX_LEN;
+
+// A fresh row holds a copy of every type collected from the next row plus the new record
+static_assert(JOURNAL_TYPES * MAX_RECORD <= Journal::ROW_SIZE - sizeof(RowHeader), "Journal row too small");
+
+static const uint8_t *rowStart(uint8_t row)
+{
+    return journalRows + (uint32_t)row * Journal::ROW_SIZE;
+}
+
+static uint16_t recordSize(uint8_t len)
+{
+    return (sizeof(RecordHeader) + len + 3) & ~3;
+}
+
+static uint16_t recordCrc(const uint8_t *record)
+{
+    return crc16(record + sizeof(RecordHeader), ((const RecordHeader *)record)->len, crc16(record, 2));
+}
+
+/*
+ * Program flash a page at a time, the NVM page buffer does not span pages
+ */
+static void program(const uint8_t *dst, const uint32_t *src, uint16_t len)
+{
+    const uint8_t *from = (const uint8_t *)src;
+    while (len > 0)
+    {
+        uint16_t chunk = NVM_PAGE_SIZE - (uintptr_t)dst % NVM_PAGE_SIZE;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+        journalFlash.write(dst, from, chunk);
+        dst += chunk;
+        from += chunk;
+        len -= chunk;
+    }
+}
+
+Journal::Journal()
+{
+    memset(latest, 0, sizeof(latest));
+    head = 0;
+    headOffset = ROW_SIZE; // Nothing written yet, the first append opens a row
+    seq = 0;
+}
+
+void Journal::begin()
+{
+    // The head is the row with the newest sequence number
+    bool found = false;
+    for (uint8_t row = 0; row < ROWS; ++row)
+    {
+        RowHeader hdr;
+        journalFlash.read(rowStart(row), &hdr, sizeof(hdr));
+        if (hdr.magic == JOURNAL_MAGIC && (!found || (int32_t)(hdr.seq - seq) > 0))
+        {
+            head = row;
+            seq = hdr.seq;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        return;
+    }
+
+    // Replay from the oldest row round to the head, later records replace earlier ones.
+    // Rows out of sequence are left from an interrupted roll or other firmware.
+    for (uint8_t i = 1; i <= ROWS; ++i)
+    {
+        uint8_t row = (head + i) % ROWS;
+        RowHeader hdr;
+        journalFlash.read(rowStart(row), &hdr, sizeof(hdr));
+        if (hdr.magic != JOURNAL_MAGIC || hdr.seq != seq - (head + ROWS - row) % ROWS)
+        {
+            continue;
+        }
+
+        uint16_t end = replayRow(row);
+        if (row == head)
+        {
+            headOffset = end;
+        }
+    }
+
+    // Finish clearing the next row if a power loss cut the last roll short
+    collect((head + 1) % ROWS);
+}
+
+/*
+ * Note the records in a row, returns the offset after the last good one
+ */
+uint16_t Journal::replayRow(uint8_t row)
+{
+    const uint8_t *base = rowStart(row);
+    uint16_t offset = sizeof(RowHeader);
+    while (offset + sizeof(RecordHeader) <= ROW_SIZE)
+    {
+        uint32_t record[(MAX_RECORD + 3) / 4];
+        const RecordHeader *hdr = (const RecordHeader *)record;
+        journalFlash.read(base + offset, record, sizeof(RecordHeader));
+        if (hdr->len == END_OF_ROW)
+        {
+            return offset;
+        }
+        if (hdr->len > MAX_LEN || offset + recordSize(hdr->len) > ROW_SIZE)
+        {
+            return ROW_SIZE; // Not written by us, nothing more goes in this row
+        }
+
+        // Skip a torn record, the one before it of its type still holds
+        journalFlash.read(base + offset, record, recordSize(hdr->len));
+        if (hdr->type != 0 && hdr->type < JOURNAL_TYPES && recordCrc((const uint8_t *)record) == hdr->crc)
+        {
+            latest[hdr->type].row = row;
+            latest[hdr->type].offset = offset;
+        }
+        offset += recordSize(hdr->len);
+    }
+    return offset;
+}
+
+bool Journal::empty() const
+{
+    for (uint8_t type = 1; type < JOURNAL_TYPES; ++type)
+    {
+        if (latest[type].offset != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Journal::load(uint8_t type, void *data, uint8_t maxLen, uint8_t &len) const
+{
+    if (type == 0 || type >= JOURNAL_TYPES || latest[type].offset == 0)
+    {
+        return false;
+    }
+
+    const uint8_t *record = rowStart(latest[type].row) + latest[type].offset;
+    RecordHeader hdr;
+    journalFlash.read(record, &hdr, sizeof(hdr));
+    if (hdr.len > maxLen)
+    {
+        return false;
+    }
+    len = hdr.len;
+    journalFlash.read(record + sizeof(hdr), data, len);
+    return true;
+}
+
+bool Journal::append(uint8_t type, const void *data, uint8_t len)
+{
+    if (type == 0 || type >= JOURNAL_TYPES || len > MAX_LEN)
+    {
+        return false;
+    }
+
+    uint32_t record[(MAX_RECORD + 3) / 4];
+    uint8_t *bytes = (uint8_t *)record;
+    uint16_t size = recordSize(len);
+    memset(bytes, 0xFF, size);
+    RecordHeader *hdr = (RecordHeader *)bytes;
+    hdr->type = type;
+    hdr->len = len;
+    memcpy(bytes + sizeof(RecordHeader), data, len);
+    hdr->crc = recordCrc(bytes);
+
+    if (headOffset + size > ROW_SIZE)
+    {
+        roll();
+    }
+    place(type, record, size);
+    return true;
+}
+
+bool Journal::update(uint8_t type, const void *data, uint8_t len)
+{
+    uint8_t current[MAX_LEN];
+    uint8_t currentLen;
+    if (load(type, current, sizeof(current), currentLen) && currentLen == len && memcmp(current, data, len) == 0)
+    {
+        return true;
+    }
+    return append(type, data, len);
+}
+
+/*
+ * Erase the next row and make it the head
+ */
+void Journal::roll()
+{
+    head = (head + 1) % ROWS;
+    ++seq;
+
+    const uint8_t *base = rowStart(head);
+    journalFlash.erase(base, ROW_SIZE);
+
+    RowHeader hdr;
+    hdr.magic = JOURNAL_MAGIC;
+    hdr.unused = 0xFFFF;
+    hdr.seq = seq;
+    program(base, (const uint32_t *)&hdr, sizeof(hdr));
+    headOffset = sizeof(hdr);
+
+    collect((head + 1) % ROWS);
+}
+
+/*
+ * Copy the latest records held in row into the head, so row can be erased
+ */
+void Journal::collect(uint8_t row)
+{
+    for (uint8_t type = 1; type < JOURNAL_TYPES; ++type)
+    {
+        if (latest[type].offset == 0 || latest[type].row != row)
+        {
+            continue;
+        }
+
+        uint32_t record[(MAX_RECORD + 3) / 4];
+        const uint8_t *from = rowStart(row) + latest[type].offset;
+        RecordHeader hdr;
+        journalFlash.read(from, &hdr, sizeof(hdr));
+        uint16_t size = recordSize(hdr.len);
+        if (headOffset + size > ROW_SIZE)
+        {
+            return; // Only after repeated power losses mid roll, the next roll loses this record
+        }
+        journalFlash.read(from, record, size);
+        place(type, record, size);
+    }
+}
+
+void Journal::place(uint8_t type, const uint32_t *record, uint16_t size)
+{
+    program(rowStart(head) + headOffset, record, size);
+    latest[type].row = head;
+    latest[type].offset = headOffset;
+    headOffset += size;
+}
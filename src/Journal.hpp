@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FlashStorage.h>
+
+/*
+ * Record types kept in the journal, the latest record of each type is its current value
+ */
+enum JournalType
+{
+    JOURNAL_CONFIG = 1,   // encodeConfig() layout
+    JOURNAL_SESSION = 2,  // LoraSession, empty once the session is dropped
+    JOURNAL_FCNT = 3,     // [devAddr u4][seqnoUp u4][seqnoDn u4], newer than the session's
+    JOURNAL_RELAY = 4,    // [state] per relay, as the schedules want it (no overrides)
+    JOURNAL_SCHEDULE = 5, // Packed schedule entries, see unpackSchedules
+    JOURNAL_SEQS = 6,     // Last command sequence numbers, for duplicate detection
+    JOURNAL_GROUP = 7,    // FrameSession of the multicast group, empty when there is none
+    JOURNAL_TYPES = 8
+};
+
+/*
+ * Append-only log of typed records over a ring of flash rows, so state that changes often
+ * goes to fresh flash instead of erasing the same row on every save.
+ *
+ * Rows are filled in turn, each starting with a header holding an increasing sequence
+ * number. When the head row is full the next row is erased and becomes the head, and the
+ * latest records still held in the row after it are copied forward, so that row can be
+ * erased on the next turn without losing anything. Each row is erased once per trip
+ * around the ring. A record torn by a power loss fails its CRC and ends its row.
+ *
+ * A journal row is four NVM rows, so one copy of every type always fits a fresh row.
+ */
+class Journal
+{
+public:
+    static const uint8_t ROWS = 8;
+    static const uint16_t ROW_SIZE = 1024;
+    static const uint8_t MAX_LEN = 80; // Bytes per record
+
+    Journal();
+
+    // Replay the flash to find the latest record of each type, call once at startup
+    void begin();
+
+    // True when no record of any type was found, a new device
+    bool empty() const;
+
+    // Copy out the latest record of type into data, false if there is none or it is longer
+    // than maxLen
+    bool load(uint8_t type, void *data, uint8_t maxLen, uint8_t &len) const;
+
+    // False if the record is too long or of an unknown type
+    bool append(uint8_t type, const void *data, uint8_t len);
+
+    // Append unless the latest record of type already holds the same data
+    bool update(uint8_t type, const void *data, uint8_t len);
+
+private:
+    // Where the latest record of a type is, offset 0 when there is none
+    struct Position
+    {
+        uint8_t row;
+        uint16_t offset;
+    };
+
+    uint16_t replayRow(uint8_t row);
+    void roll();
+    void collect(uint8_t row);
+    void place(uint8_t type, const uint32_t *record, uint16_t size);
+
+    Position latest[JOURNAL_TYPES];
+    uint8_t head;
+    uint16_t headOffset; // Where the next record goes in the head row
+    uint32_t seq;        // Sequence number of the head row
+};
@@ -0,0 +1,52 @@
+#include <LinkMonitor.hpp>
+
+LinkMonitor::LinkMonitor() : linkState(LINK_UP), missCount(0), joinCount(0), rejoinSec(REJOIN_MIN_SEC)
+{
+}
+
+void LinkMonitor::heard()
+{
+    linkState = LINK_UP;
+    missCount = 0;
+    joinCount = 0;
+    rejoinSec = REJOIN_MIN_SEC;
+}
+
+void LinkMonitor::missed()
+{
+    if (missCount < 0xFF)
+    {
+        ++missCount;
+    }
+    if (missCount >= OFFLINE_MISSES)
+    {
+        linkState = LINK_OFFLINE;
+    }
+    else if (missCount >= DEGRADED_MISSES && linkState == LINK_UP)
+    {
+        linkState = LINK_DEGRADED;
+    }
+}
+
+void LinkMonitor::linkDead()
+{
+    linkState = linkState == LINK_UP ? LINK_DEGRADED : LINK_OFFLINE;
+}
+
+bool LinkMonitor::joinUnanswered()
+{
+    return ++joinCount >= JOIN_ATTEMPTS;
+}
+
+void LinkMonitor::joinFailed()
+{
+    linkState = LINK_OFFLINE;
+    joinCount = 0;
+}
+
+uint32_t LinkMonitor::nextRejoinSec()
+{
+    uint32_t wait = rejoinSec;
+    rejoinSec = rejoinSec * 2 > REJOIN_MAX_SEC ? REJOIN_MAX_SEC : rejoinSec * 2;
+    return wait;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Connectivity as seen from acks and downlinks
+ */
+enum LinkState
+{
+    LINK_UP,       // Heard from the network recently
+    LINK_DEGRADED, // Confirmed uplinks going unanswered
+    LINK_OFFLINE   // Given up on the session, only rejoin attempts go out
+};
+
+/*
+ * Tracks the link from uplink outcomes and decides what may be sent. Once offline,
+ * rejoin attempts are spaced out with an exponential backoff so a gateway outage does
+ * not burn airtime and power.
+ */
+class LinkMonitor
+{
+public:
+    static const uint8_t DEGRADED_MISSES = 2; // Unacked confirmed uplinks before degraded
+    static const uint8_t OFFLINE_MISSES = 4;  // and before offline
+    static const uint32_t REJOIN_MIN_SEC = 60;
+    static const uint32_t REJOIN_MAX_SEC = 1800;
+    static const uint8_t JOIN_ATTEMPTS = 8; // Unanswered join requests before backing off
+
+    LinkMonitor();
+
+    LinkState state() const { return linkState; }
+    uint8_t misses() const { return missCount; }
+
+    // Ack or downlink received, or joined
+    void heard();
+
+    // Confirmed uplink not acked
+    void missed();
+
+    // LMIC reports the link dead (no reply to ADR ack requests)
+    void linkDead();
+
+    // A join request got no accept, true once JOIN_ATTEMPTS in a row went unanswered
+    bool joinUnanswered();
+
+    // LMIC gave up joining, or joinUnanswered() said to back off
+    void joinFailed();
+
+    // Whether uplinks may be sent, degraded still sends everything as the confirmed
+    // uplinks are what finds the link again
+    bool canSend() const { return linkState != LINK_OFFLINE; }
+
+    // Seconds to wait before the next rejoin attempt, each call doubles the next wait
+    uint32_t nextRejoinSec();
+
+private:
+    LinkState linkState;
+    uint8_t missCount;
+    uint8_t joinCount;
+    uint32_t rejoinSec;
+};
@@ -0,0 +1,74 @@
+#include <LinkQuality.hpp>
+
+static int32_t ewma(int32_t avg, int32_t value, uint8_t weight)
+{
+    return avg + (value - avg) / weight;
+}
+
+LinkQuality::LinkQuality() : rssiAvg(0), snrAvg(0), lossAvg(0), samples(0)
+{
+}
+
+void LinkQuality::sample(int16_t rssi, int8_t snr)
+{
+    if (samples == 0)
+    {
+        rssiAvg = (int32_t)rssi * SCALE;
+        snrAvg = (int32_t)snr * SCALE;
+    }
+    else
+    {
+        rssiAvg = ewma(rssiAvg, (int32_t)rssi * SCALE, WEIGHT);
+        snrAvg = ewma(snrAvg, (int32_t)snr * SCALE, WEIGHT);
+    }
+    if (samples < 0xFFFF)
+    {
+        ++samples;
+    }
+}
+
+void LinkQuality::ackResult(bool acked)
+{
+    lossAvg = ewma(lossAvg, acked ? 0 : 100 * SCALE, WEIGHT);
+}
+
+int16_t LinkQuality::rssi() const
+{
+    return rssiAvg / SCALE;
+}
+
+int8_t LinkQuality::snr() const
+{
+    return snrAvg / SCALE;
+}
+
+uint8_t LinkQuality::lossPercent() const
+{
+    return lossAvg / SCALE;
+}
+
+uint8_t LinkQuality::chooseDr() const
+{
+    if (!valid())
+    {
+        return 0;
+    }
+
+    // Demodulation floor is -7.5 dB at SF7, 2.5 dB lower for each step in SF
+    uint8_t dr = 0;
+    for (uint8_t d = MAX_DR; d > 0; --d)
+    {
+        int16_t snrFloor = -30 - 10 * (MAX_DR - d);
+        if (snr() - snrFloor >= SNR_MARGIN)
+        {
+            dr = d;
+            break;
+        }
+    }
+
+    if (dr > 0 && lossPercent() >= LOSS_STEP_DOWN)
+    {
+        --dr;
+    }
+    return dr;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Rolling estimate of the link from the frames the node receives: EWMA of RSSI and SNR,
+ * and of the share of confirmed uplinks that got no ack. Used to pick the uplink data
+ * rate when ADR is off, on the assumption the link is about as good in both directions.
+ */
+class LinkQuality
+{
+public:
+    static const uint8_t MAX_DR = 3;         // US915 125 kHz data rates, DR0 = SF10 ... DR3 = SF7
+    static const int8_t SNR_MARGIN = 10 * 4; // dB * 4 above the demodulation floor
+    static const uint8_t LOSS_STEP_DOWN = 20; // Percent lost before dropping a data rate
+
+    LinkQuality();
+
+    // Frame received, snr in dB * 4 as LMIC reports it
+    void sample(int16_t rssi, int8_t snr);
+
+    // Outcome of a confirmed uplink
+    void ackResult(bool acked);
+
+    bool valid() const { return samples > 0; }
+    int16_t rssi() const;        // dBm
+    int8_t snr() const;          // dB * 4
+    uint8_t lossPercent() const; // Confirmed uplinks not acked
+
+    // Fastest data rate with enough SNR margin, DR0 until there is a sample
+    uint8_t chooseDr() const;
+
+private:
+    static const uint8_t WEIGHT = 8; // EWMA weight 1 / WEIGHT
+    static const uint8_t SCALE = 16; // Fixed point fraction bits of the averages
+
+    int32_t rssiAvg; // dBm * SCALE
+    int32_t snrAvg;  // dB * 4 * SCALE
+    int32_t lossAvg; // Percent * SCALE
+    uint16_t samples;
+};
@@ -0,0 +1,334 @@
+#include <MsgPackReader.hpp>
+#include <strings.h>
+
+// Deepest map / array nesting skip() will follow
+static const uint8_t MAX_SKIP_DEPTH = 8;
+
+MsgPackReader::MsgPackReader(const uint8_t *buf, size_t len)
+    : pos(buf), end(buf + len), failed(false)
+{
+}
+
+bool MsgPackReader::fail()
+{
+    failed = true;
+    return false;
+}
+
+bool MsgPackReader::take(size_t n, const uint8_t *&p)
+{
+    if (failed || (size_t)(end - pos) < n)
+    {
+        return fail();
+    }
+    p = pos;
+    pos += n;
+    return true;
+}
+
+// Big endian length / value of 1, 2 or 4 bytes
+bool MsgPackReader::readLength(uint8_t lenBytes, uint32_t &len)
+{
+    const uint8_t *p;
+    if (!take(lenBytes, p))
+    {
+        return false;
+    }
+    len = 0;
+    for (uint8_t i = 0; i < lenBytes; ++i)
+    {
+        len = (len << 8) | p[i];
+    }
+    return true;
+}
+
+MsgPackReader::Type MsgPackReader::peek() const
+{
+    if (failed || pos == end)
+    {
+        return INVALID;
+    }
+
+    uint8_t b = *pos;
+    if (b <= 0x7F || b >= 0xE0 || (b >= 0xCC && b <= 0xD3))
+    {
+        return INT;
+    }
+    if ((b & 0xF0) == 0x80 || b == 0xDE || b == 0xDF)
+    {
+        return MAP;
+    }
+    if ((b & 0xF0) == 0x90 || b == 0xDC || b == 0xDD)
+    {
+        return ARRAY;
+    }
+    if ((b & 0xE0) == 0xA0 || (b >= 0xD9 && b <= 0xDB))
+    {
+        return STR;
+    }
+
+    switch (b)
+    {
+    case 0xC0:
+        return NIL;
+    case 0xC2:
+    case 0xC3:
+        return BOOL;
+    case 0xC4:
+    case 0xC5:
+    case 0xC6:
+        return BIN;
+    case 0xCA:
+    case 0xCB:
+        return FLOAT;
+    case 0xC7:
+    case 0xC8:
+    case 0xC9:
+    case 0xD4:
+    case 0xD5:
+    case 0xD6:
+    case 0xD7:
+    case 0xD8:
+        return EXT;
+    default:
+        return INVALID;
+    }
+}
+
+bool MsgPackReader::readMap(uint32_t &members)
+{
+    if (peek() != MAP)
+    {
+        return fail();
+    }
+
+    uint8_t b = *pos++;
+    if (b <= 0x8F)
+    {
+        members = b & 0x0F;
+        return true;
+    }
+    return readLength(b == 0xDE ? 2 : 4, members);
+}
+
+bool MsgPackReader::readArray(uint32_t &elements)
+{
+    if (peek() != ARRAY)
+    {
+        return fail();
+    }
+
+    uint8_t b = *pos++;
+    if (b <= 0x9F)
+    {
+        elements = b & 0x0F;
+        return true;
+    }
+    return readLength(b == 0xDC ? 2 : 4, elements);
+}
+
+bool MsgPackReader::readStr(const char *&str, uint32_t &len)
+{
+    if (peek() != STR)
+    {
+        return fail();
+    }
+
+    uint8_t b = *pos++;
+    if (b <= 0xBF)
+    {
+        len = b & 0x1F;
+    }
+    else if (!readLength(1 << (b - 0xD9), len))
+    {
+        return false;
+    }
+
+    const uint8_t *p;
+    if (!take(len, p))
+    {
+        return false;
+    }
+    str = (const char *)p;
+    return true;
+}
+
+bool MsgPackReader::readBool(bool &value)
+{
+    if (peek() != BOOL)
+    {
+        return fail();
+    }
+    value = *pos++ == 0xC3;
+    return true;
+}
+
+bool MsgPackReader::readInt(int32_t &value)
+{
+    if (peek() != INT)
+    {
+        return fail();
+    }
+
+    uint8_t b = *pos++;
+    if (b <= 0x7F)
+    {
+        value = b;
+        return true;
+    }
+    if (b >= 0xE0)
+    {
+        value = (int8_t)b;
+        return true;
+    }
+
+    uint32_t raw;
+    switch (b)
+    {
+    case 0xCC: // uint 8, 16, 32
+    case 0xCD:
+    case 0xCE:
+        if (!readLength(1 << (b - 0xCC), raw) || raw > 0x7FFFFFFF)
+        {
+            return fail();
+        }
+        value = raw;
+        return true;
+    case 0xD0: // int 8
+        if (!readLength(1, raw))
+        {
+            return false;
+        }
+        value = (int8_t)raw;
+        return true;
+    case 0xD1: // int 16
+        if (!readLength(2, raw))
+        {
+            return false;
+        }
+        value = (int16_t)raw;
+        return true;
+    case 0xD2: // int 32
+        if (!readLength(4, raw))
+        {
+            return false;
+        }
+        value = (int32_t)raw;
+        return true;
+    default: // 64 bit values do not fit
+        return fail();
+    }
+}
+
+bool MsgPackReader::readUint(uint32_t &value)
+{
+    if (peek() == INT && *pos >= 0xCC && *pos <= 0xCE)
+    {
+        uint8_t b = *pos++;
+        return readLength(1 << (b - 0xCC), value);
+    }
+
+    int32_t v;
+    if (!readInt(v) || v < 0)
+    {
+        return fail();
+    }
+    value = v;
+    return true;
+}
+
+bool MsgPackReader::skip()
+{
+    // Count of values still to skip, maps count each key and value
+    uint32_t pending[MAX_SKIP_DEPTH];
+    uint8_t depth = 0;
+    pending[0] = 1;
+
+    while (!failed)
+    {
+        if (pending[depth] == 0)
+        {
+            if (depth == 0)
+            {
+                return true;
+            }
+            --depth;
+            continue;
+        }
+        --pending[depth];
+
+        uint32_t n = 0;
+        const uint8_t *p;
+        uint8_t b = pos < end ? *pos : 0;
+        switch (peek())
+        {
+        case NIL:
+        case BOOL:
+            ++pos;
+            break;
+        case INT:
+            ++pos;
+            if (b >= 0xCC && b <= 0xD3)
+            {
+                take(1 << ((b - 0xCC) & 0x03), p);
+            }
+            break;
+        case FLOAT:
+            ++pos;
+            take(b == 0xCA ? 4 : 8, p);
+            break;
+        case STR:
+        {
+            const char *s;
+            readStr(s, n);
+            break;
+        }
+        case BIN:
+            ++pos;
+            if (readLength(1 << (b - 0xC4), n))
+            {
+                take(n, p);
+            }
+            break;
+        case EXT:
+            ++pos;
+            if (b >= 0xD4)
+            {
+                take(1 + (1 << (b - 0xD4)), p);
+            }
+            else if (readLength(1 << (b - 0xC7), n))
+            {
+                take(1 + n, p);
+            }
+            break;
+        case ARRAY:
+        case MAP:
+        {
+            bool isMap = peek() == MAP;
+            if (isMap ? !readMap(n) : !readArray(n))
+            {
+                return false;
+            }
+            // Every value takes a byte at least, a larger count is corrupt and n * 2 could wrap
+            if (n > (uint32_t)(end - pos) || depth + 1 >= MAX_SKIP_DEPTH)
+            {
+                return fail();
+            }
+            pending[++depth] = isMap ? n * 2 : n;
+            break;
+        }
+        default:
+            return fail();
+        }
+    }
+    return false;
+}
+
+bool msgPackStrEquals(const char *str, uint32_t len, const char *expected, bool ignoreCase)
+{
+    if (strlen(expected) != len)
+    {
+        return false;
+    }
+    return ignoreCase ? strncasecmp(str, expected, len) == 0 : strncmp(str, expected, len) == 0;
+}
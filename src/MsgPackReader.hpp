@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Pull style MessagePack reader over a received buffer. Values are read in order with
+ * the read calls, strings are returned as pointers into the buffer so nothing is copied
+ * or allocated. Any error (bad type, truncated data) sticks, see ok().
+ */
+class MsgPackReader
+{
+public:
+    enum Type
+    {
+        NIL,
+        BOOL,
+        INT,
+        FLOAT,
+        STR,
+        BIN,
+        ARRAY,
+        MAP,
+        EXT,
+        INVALID
+    };
+
+    MsgPackReader(const uint8_t *buf, size_t len);
+
+    // Type of the next value without consuming it
+    Type peek() const;
+
+    bool readMap(uint32_t &members);
+    bool readArray(uint32_t &elements);
+    bool readStr(const char *&str, uint32_t &len);
+    bool readBool(bool &value);
+    bool readInt(int32_t &value);
+    bool readUint(uint32_t &value);
+
+    // Skip over the next value, including everything inside a map or array
+    bool skip();
+
+    bool ok() const { return !failed; }
+    bool atEnd() const { return pos == end; }
+
+private:
+    bool fail();
+    bool take(size_t n, const uint8_t *&p);
+    bool readLength(uint8_t lenBytes, uint32_t &len);
+
+    const uint8_t *pos;
+    const uint8_t *end;
+    bool failed;
+};
+
+/*
+ * Compare a string returned by readStr() with a C string
+ */
+bool msgPackStrEquals(const char *str, uint32_t len, const char *expected, bool ignoreCase = false);
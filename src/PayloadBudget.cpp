@@ -0,0 +1,58 @@
+#include <PayloadBudget.hpp>
+
+/*
+ * LoRaWAN Regional Parameters, US902-928 maximum payload size (M) for DR0 - DR4.
+ * DR5 - DR7 are reserved and DR8 - DR13 are downlink only.
+ */
+static const uint8_t US915_MAX_PAYLOAD[] = {11, 53, 125, 242, 242};
+
+uint8_t maxAppPayload(uint8_t dr)
+{
+    if (dr >= sizeof(US915_MAX_PAYLOAD))
+    {
+        return 0;
+    }
+    return US915_MAX_PAYLOAD[dr];
+}
+
+// MessagePack size of a map member, key string plus the value
+static size_t memberSize(JsonDocument &doc, const char *key)
+{
+    size_t keyLen = strlen(key);
+    return (keyLen < 32 ? 1 : 2) + keyLen + measureMsgPack(doc[key]);
+}
+
+int trimToBudget(JsonDocument &doc, size_t budget, const char *const fields[], uint8_t fieldCount)
+{
+    size_t size = measureMsgPack(doc);
+    if (size <= budget)
+    {
+        return 0;
+    }
+
+    // See if the required members fit on their own before touching the document
+    size_t required = size;
+    for (uint8_t i = 0; i < fieldCount; ++i)
+    {
+        if (doc.containsKey(fields[i]))
+        {
+            required -= memberSize(doc, fields[i]);
+        }
+    }
+    if (required > budget)
+    {
+        return -1;
+    }
+
+    int removed = 0;
+    for (uint8_t i = 0; i < fieldCount && size > budget; ++i)
+    {
+        if (doc.containsKey(fields[i]))
+        {
+            size -= memberSize(doc, fields[i]);
+            doc.remove(fields[i]);
+            ++removed;
+        }
+    }
+    return removed;
+}
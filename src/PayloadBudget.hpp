@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/*
+ * Largest application payload that can be sent at a US915 uplink data rate,
+ * 0 for the data rates that are not used for uplinks.
+ */
+uint8_t maxAppPayload(uint8_t dr);
+
+/*
+ * Remove optional members of a MessagePack command until it fits in budget.
+ *   fields - optional member names, lowest priority (first to go) first
+ *   Return value: number of members removed, or -1 if the message would not fit
+ *                 even without all of them, in which case the document is untouched.
+ */
+int trimToBudget(JsonDocument &doc, size_t budget, const char *const fields[], uint8_t fieldCount);
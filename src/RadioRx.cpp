@@ -0,0 +1,129 @@
+#include <RadioRx.hpp>
+#include <hal/hal.h>
+
+// SX127x LoRa mode registers
+static const uint8_t REG_FIFO = 0x00;
+static const uint8_t REG_OP_MODE = 0x01;
+static const uint8_t REG_FRF_MSB = 0x06;
+static const uint8_t REG_LNA = 0x0C;
+static const uint8_t REG_FIFO_ADDR_PTR = 0x0D;
+static const uint8_t REG_FIFO_RX_BASE_ADDR = 0x0F;
+static const uint8_t REG_FIFO_RX_CURRENT_ADDR = 0x10;
+static const uint8_t REG_IRQ_FLAGS_MASK = 0x11;
+static const uint8_t REG_IRQ_FLAGS = 0x12;
+static const uint8_t REG_RX_NB_BYTES = 0x13;
+static const uint8_t REG_PKT_SNR_VALUE = 0x19;
+static const uint8_t REG_PKT_RSSI_VALUE = 0x1A;
+static const uint8_t REG_MODEM_CONFIG_1 = 0x1D;
+static const uint8_t REG_MODEM_CONFIG_2 = 0x1E;
+static const uint8_t REG_PREAMBLE_MSB = 0x20;
+static const uint8_t REG_PREAMBLE_LSB = 0x21;
+static const uint8_t REG_PAYLOAD_MAX_LENGTH = 0x23;
+static const uint8_t REG_MODEM_CONFIG_3 = 0x26;
+static const uint8_t REG_INVERT_IQ = 0x33;
+static const uint8_t REG_SYNC_WORD = 0x39;
+static const uint8_t REG_INVERT_IQ_2 = 0x3B;
+static const uint8_t REG_DIO_MAPPING_1 = 0x40;
+
+static const uint8_t MODE_LORA = 0x80;
+static const uint8_t MODE_SLEEP = 0x00;
+static const uint8_t MODE_STANDBY = 0x01;
+static const uint8_t MODE_RX_CONTINUOUS = 0x05;
+
+static const uint8_t IRQ_RX_DONE = 0x40;
+static const uint8_t IRQ_PAYLOAD_CRC_ERROR = 0x20;
+
+static const uint8_t INVERT_IQ_RX = 0x40;
+static const uint8_t INVERT_IQ_2_ON = 0x19;
+static const uint8_t INVERT_IQ_2_OFF = 0x1D;
+static const uint8_t DIO0_CAD_DONE = 0x80;
+static const uint8_t DIO1_CAD_DETECTED = 0x20;
+static const uint8_t LNA_MAX_GAIN = 0x23;
+static const uint8_t SYNC_WORD_LORAWAN = 0x34;
+static const uint8_t AGC_AUTO_ON = 0x04;
+static const uint8_t LOW_DATA_RATE_OPTIMIZE = 0x08;
+static const uint8_t PREAMBLE_SYMBOLS = 8;
+static const int16_t RSSI_OFFSET_HF = -157;
+
+static void writeReg(uint8_t reg, uint8_t value)
+{
+    hal_spi_write(reg | 0x80, &value, 1);
+}
+
+static uint8_t readReg(uint8_t reg)
+{
+    uint8_t value;
+    hal_spi_read(reg & 0x7F, &value, 1);
+    return value;
+}
+
+void radioRxStart(uint32_t freq, rps_t rps)
+{
+    // The LoRa mode bit only changes in sleep
+    writeReg(REG_OP_MODE, MODE_LORA | MODE_SLEEP);
+    writeReg(REG_OP_MODE, MODE_LORA | MODE_STANDBY);
+
+    uint32_t frf = (uint32_t)(((uint64_t)freq << 19) / 32000000);
+    uint8_t frfBytes[] = {(uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)frf};
+    hal_spi_write(REG_FRF_MSB | 0x80, frfBytes, sizeof(frfBytes));
+
+    // Explicit header and no payload CRC, as LoRaWAN downlinks are sent
+    uint8_t sf = getSf(rps) - SF7 + 7;
+    uint8_t bw = getBw(rps);
+    writeReg(REG_MODEM_CONFIG_1, ((7 + bw) << 4) | ((getCr(rps) + 1) << 1));
+    writeReg(REG_MODEM_CONFIG_2, sf << 4);
+    // Symbols longer than 16 ms need the low data rate optimisation
+    bool ldro = (1UL << sf) > 16UL * (125UL << bw);
+    writeReg(REG_MODEM_CONFIG_3, AGC_AUTO_ON | (ldro ? LOW_DATA_RATE_OPTIMIZE : 0));
+
+    writeReg(REG_PREAMBLE_MSB, 0);
+    writeReg(REG_PREAMBLE_LSB, PREAMBLE_SYMBOLS);
+    writeReg(REG_PAYLOAD_MAX_LENGTH, 0xFF);
+    writeReg(REG_SYNC_WORD, SYNC_WORD_LORAWAN);
+    writeReg(REG_INVERT_IQ, readReg(REG_INVERT_IQ) | INVERT_IQ_RX);
+    writeReg(REG_INVERT_IQ_2, INVERT_IQ_2_ON);
+    writeReg(REG_LNA, LNA_MAX_GAIN);
+    writeReg(REG_FIFO_RX_BASE_ADDR, 0);
+    writeReg(REG_FIFO_ADDR_PTR, 0);
+
+    // Keep RX done and RX timeout off the DIO lines the HAL watches
+    writeReg(REG_DIO_MAPPING_1, DIO0_CAD_DONE | DIO1_CAD_DETECTED);
+    writeReg(REG_IRQ_FLAGS_MASK, 0);
+    writeReg(REG_IRQ_FLAGS, 0xFF);
+
+    writeReg(REG_OP_MODE, MODE_LORA | MODE_RX_CONTINUOUS);
+}
+
+uint8_t radioRxPoll(uint8_t *buf, uint8_t maxLen, int16_t &rssi, int8_t &snr)
+{
+    uint8_t flags = readReg(REG_IRQ_FLAGS);
+    if ((flags & IRQ_RX_DONE) == 0)
+    {
+        return 0;
+    }
+    writeReg(REG_IRQ_FLAGS, 0xFF);
+    if (flags & IRQ_PAYLOAD_CRC_ERROR)
+    {
+        return 0;
+    }
+
+    uint8_t len = readReg(REG_RX_NB_BYTES);
+    if (len > maxLen)
+    {
+        return 0;
+    }
+    writeReg(REG_FIFO_ADDR_PTR, readReg(REG_FIFO_RX_CURRENT_ADDR));
+    hal_spi_read(REG_FIFO, buf, len);
+
+    snr = (int8_t)readReg(REG_PKT_SNR_VALUE);
+    rssi = RSSI_OFFSET_HF + readReg(REG_PKT_RSSI_VALUE);
+    return len;
+}
+
+void radioRxStop()
+{
+    writeReg(REG_OP_MODE, MODE_LORA | MODE_SLEEP);
+    writeReg(REG_INVERT_IQ, readReg(REG_INVERT_IQ) & ~INVERT_IQ_RX);
+    writeReg(REG_INVERT_IQ_2, INVERT_IQ_2_OFF);
+    writeReg(REG_IRQ_FLAGS, 0xFF);
+}
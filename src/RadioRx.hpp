@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+#include <lmic.h>
+
+/*
+ * Continuous LoRa receive on the SX127x for frames LMIC does not listen for (RX2 between
+ * uplinks for Class C and the multicast group).
+ *
+ * The radio is programmed through the HAL's SPI access, outside the LMIC radio driver:
+ * that driver reports every radio event through LMIC's own engine job. DIO0 and DIO1 are
+ * mapped to the CAD interrupts, which never fire while receiving, so the HAL does not
+ * run the LMIC radio handler either. Received frames are picked up by polling the IRQ
+ * flags from an application job.
+ *
+ * Only start while LMIC is idle and stop before handing the radio back, LMIC programs
+ * the radio from scratch for every transmit and receive window.
+ */
+
+// Put the radio in continuous receive on freq (Hz) with the spreading factor, bandwidth
+// and coding rate of rps, IQ inverted as for downlinks
+void radioRxStart(uint32_t freq, rps_t rps);
+
+// Copy a frame received since the last poll into buf, up to maxLen bytes. Returns the
+// frame length, 0 if nothing arrived. rssi is in dBm, snr in dB * 4 as LMIC.snr.
+uint8_t radioRxPoll(uint8_t *buf, uint8_t maxLen, int16_t &rssi, int8_t &snr);
+
+// Put the radio to sleep and undo the IQ inversion
+void radioRxStop();
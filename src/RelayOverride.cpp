@@ -0,0 +1,66 @@
+#include <RelayOverride.hpp>
+
+RelayOverride::RelayOverride()
+{
+    memset(channels, 0, sizeof(channels));
+}
+
+void RelayOverride::set(uint8_t ch, bool state, uint32_t durationMs, uint32_t nowMs)
+{
+    Channel &c = channels[ch];
+    c.active = true;
+    c.state = state;
+    c.startMs = nowMs;
+    c.durationMs = durationMs;
+}
+
+void RelayOverride::clear(uint8_t ch)
+{
+    channels[ch].active = false;
+}
+
+bool RelayOverride::expire(uint32_t nowMs)
+{
+    bool expired = false;
+    for (uint8_t ch = 0; ch < CHANNELS; ++ch)
+    {
+        Channel &c = channels[ch];
+        if (c.active && nowMs - c.startMs >= c.durationMs)
+        {
+            c.active = false;
+            expired = true;
+        }
+    }
+    return expired;
+}
+
+uint32_t RelayOverride::remainingSec(uint8_t ch, uint32_t nowMs) const
+{
+    const Channel &c = channels[ch];
+    uint32_t elapsed = nowMs - c.startMs;
+    if (!c.active || elapsed >= c.durationMs)
+    {
+        return 0;
+    }
+    return (c.durationMs - elapsed + 999) / 1000;
+}
+
+uint32_t RelayOverride::msToExpiry(uint32_t nowMs) const
+{
+    uint32_t next = 0xFFFFFFFF;
+    for (uint8_t ch = 0; ch < CHANNELS; ++ch)
+    {
+        const Channel &c = channels[ch];
+        if (!c.active)
+        {
+            continue;
+        }
+        uint32_t elapsed = nowMs - c.startMs;
+        uint32_t left = elapsed >= c.durationMs ? 0 : c.durationMs - elapsed;
+        if (left < next)
+        {
+            next = left;
+        }
+    }
+    return next;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Manual on / off per relay channel for a limited time, taking precedence over the
+ * schedules until it expires. Times are millis() so a clock change does not shorten
+ * or extend an override.
+ */
+class RelayOverride
+{
+public:
+    static const uint8_t CHANNELS = 2;
+
+    RelayOverride();
+
+    void set(uint8_t ch, bool state, uint32_t durationMs, uint32_t nowMs);
+    void clear(uint8_t ch);
+
+    // Drop overrides that have run out, true if any did
+    bool expire(uint32_t nowMs);
+
+    bool active(uint8_t ch) const { return channels[ch].active; }
+    bool state(uint8_t ch) const { return channels[ch].state; }
+
+    // Seconds left on the override, 0 when there is none
+    uint32_t remainingSec(uint8_t ch, uint32_t nowMs) const;
+
+    // Time until the next override expires, 0xFFFFFFFF when there is none
+    uint32_t msToExpiry(uint32_t nowMs) const;
+
+private:
+    struct Channel
+    {
+        bool active;
+        bool state;
+        uint32_t startMs;
+        uint32_t durationMs;
+    };
+
+    Channel channels[CHANNELS];
+};
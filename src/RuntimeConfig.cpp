@@ -0,0 +1,173 @@
+#include <RuntimeConfig.hpp>
+
+void encodeConfig(const RuntimeConfig &config, uint8_t *buf)
+{
+    buf[0] = RuntimeConfig::VERSION;
+    buf[1] = config.txInterval;
+    buf[2] = config.txInterval >> 8;
+    buf[3] = config.statusPeriod;
+    buf[4] = config.statusPeriod >> 8;
+    buf[5] = config.logging ? 1 : 0;
+    buf[6] = config.subBand;
+    buf[7] = (uint16_t)config.tzMinutes;
+    buf[8] = (uint16_t)config.tzMinutes >> 8;
+    buf[9] = config.adr ? 1 : 0;
+    buf[10] = config.airHourSec;
+    buf[11] = config.airHourSec >> 8;
+    buf[12] = config.airDaySec;
+    buf[13] = config.airDaySec >> 8;
+}
+
+static bool decodeConfig(const uint8_t *buf, uint8_t len, RuntimeConfig &config)
+{
+    if (len != RuntimeConfig::ENCODED_LEN || buf[0] != RuntimeConfig::VERSION)
+    {
+        return false;
+    }
+    uint8_t patch[] = {
+        CFG_TX_INTERVAL, buf[1], buf[2],
+        CFG_STATUS_PERIOD, buf[3], buf[4],
+        CFG_LOGGING, buf[5],
+        CFG_SUB_BAND, buf[6],
+        CFG_TZ_OFFSET, buf[7], buf[8],
+        CFG_ADR, buf[9],
+        CFG_AIR_HOUR, buf[10], buf[11],
+        CFG_AIR_DAY, buf[12], buf[13]};
+    return patchConfig(config, patch, sizeof(patch));
+}
+
+static uint8_t fieldLen(uint8_t field)
+{
+    switch (field)
+    {
+    case CFG_TX_INTERVAL:
+    case CFG_STATUS_PERIOD:
+    case CFG_TZ_OFFSET:
+    case CFG_AIR_HOUR:
+    case CFG_AIR_DAY:
+        return 2;
+    case CFG_LOGGING:
+    case CFG_SUB_BAND:
+    case CFG_ADR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+bool patchConfig(RuntimeConfig &config, const uint8_t *patch, uint8_t len)
+{
+    RuntimeConfig next = config;
+    uint8_t pos = 0;
+    while (pos < len)
+    {
+        uint8_t field = patch[pos++];
+        uint8_t size = fieldLen(field);
+        if (size == 0 || pos + size > len)
+        {
+            return false;
+        }
+
+        const uint8_t *v = patch + pos;
+        uint16_t value = size == 2 ? v[0] | (v[1] << 8) : v[0];
+        pos += size;
+
+        switch (field)
+        {
+        case CFG_TX_INTERVAL:
+            if (value < 10 || value > 3600)
+            {
+                return false;
+            }
+            next.txInterval = value;
+            break;
+        case CFG_STATUS_PERIOD:
+            if (value < 60 || value > 86400 / 2)
+            {
+                return false;
+            }
+            next.statusPeriod = value;
+            break;
+        case CFG_LOGGING:
+            if (value > 1)
+            {
+                return false;
+            }
+            next.logging = value == 1;
+            break;
+        case CFG_SUB_BAND:
+            if (value > 7)
+            {
+                return false;
+            }
+            next.subBand = value;
+            break;
+        case CFG_TZ_OFFSET:
+            if ((int16_t)value < -12 * 60 || (int16_t)value > 14 * 60)
+            {
+                return false;
+            }
+            next.tzMinutes = (int16_t)value;
+            break;
+        case CFG_ADR:
+            if (value > 1)
+            {
+                return false;
+            }
+            next.adr = value == 1;
+            break;
+        case CFG_AIR_HOUR:
+            if (value < 1 || value > 3600)
+            {
+                return false;
+            }
+            next.airHourSec = value;
+            break;
+        case CFG_AIR_DAY:
+            // The ledger works in ms, 75 % of the budget has to fit 32 bits
+            if (value < 1 || value > 86400 / 2)
+            {
+                return false;
+            }
+            next.airDaySec = value;
+            break;
+        }
+    }
+
+    // The heartbeat runs on the work interval, so it cannot be shorter
+    if (next.statusPeriod < next.txInterval)
+    {
+        return false;
+    }
+
+    // A day holds the last hour
+    if (next.airDaySec < next.airHourSec)
+    {
+        return false;
+    }
+
+    config = next;
+    return true;
+}
+
+ConfigStore::ConfigStore(Journal &journal) : journal(journal)
+{
+}
+
+bool ConfigStore::load(RuntimeConfig &config)
+{
+    uint8_t buf[Journal::MAX_LEN];
+    uint8_t len;
+    if (!journal.load(JOURNAL_CONFIG, buf, sizeof(buf), len))
+    {
+        return false;
+    }
+    return decodeConfig(buf, len, config);
+}
+
+void ConfigStore::save(const RuntimeConfig &config)
+{
+    uint8_t buf[RuntimeConfig::ENCODED_LEN];
+    encodeConfig(config, buf);
+    journal.update(JOURNAL_CONFIG, buf, sizeof(buf));
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Journal.hpp>
+
+/*
+ * Settings that can be changed over the air, kept in the journal with a version.
+ * Sent and patched in this little endian layout:
+ *
+ *   [version][tx interval s u2][status period s u2][logging][sub-band][tz offset min i2][adr]
+ *   [airtime per hour s u2][airtime per day s u2]
+ */
+struct RuntimeConfig
+{
+    static const uint8_t VERSION = 3;
+    static const uint8_t ENCODED_LEN = 14;
+
+    uint16_t txInterval;   // Seconds between work runs / uplink attempts
+    uint16_t statusPeriod; // Seconds between heartbeats
+    bool logging;          // Log to SerialUSB
+    uint8_t subBand;       // US915 sub-band, 0 - 7
+    int16_t tzMinutes;     // Local time offset from UTC, schedules run on local time
+    bool adr;              // Network sets the data rate, otherwise it follows LinkQuality
+    uint16_t airHourSec;   // Uplink airtime budget per rolling hour, see AirtimeLedger
+    uint16_t airDaySec;    // Uplink airtime budget per rolling day
+};
+
+/*
+ * Patchable fields, a patch is a list of [field][value] with the value sized as above
+ */
+enum ConfigField
+{
+    CFG_TX_INTERVAL = 1,
+    CFG_STATUS_PERIOD = 2,
+    CFG_LOGGING = 3,
+    CFG_SUB_BAND = 4,
+    CFG_TZ_OFFSET = 5,
+    CFG_ADR = 6,
+    CFG_AIR_HOUR = 7,
+    CFG_AIR_DAY = 8
+};
+
+// Write the layout above into buf, ENCODED_LEN bytes
+void encodeConfig(const RuntimeConfig &config, uint8_t *buf);
+
+/*
+ * Apply a patch to config. All fields are checked first, false if any field is unknown,
+ * truncated or out of range, config is then left untouched.
+ */
+bool patchConfig(RuntimeConfig &config, const uint8_t *patch, uint8_t len);
+
+/*
+ * The configuration held in the journal
+ */
+class ConfigStore
+{
+public:
+    ConfigStore(Journal &journal);
+
+    // Load the stored configuration, false (and config untouched) if there is none,
+    // it is corrupt or from another version
+    bool load(RuntimeConfig &config);
+
+    void save(const RuntimeConfig &config);
+
+private:
+    Journal &journal;
+};
@@ -0,0 +1,165 @@
+#include <ScheduleCache.hpp>
+
+static const uint16_t SLOT_MAGIC = 0x5343;
+
+// One row per slot, rows must be erased whole
+__attribute__((__aligned__(ScheduleCache::ROW_SIZE))) static const uint8_t cacheRows[ScheduleCache::SLOTS * ScheduleCache::ROW_SIZE] = {};
+static FlashClass cacheFlash(cacheRows, sizeof(cacheRows));
+
+bool unpackSchedules(const uint8_t *data, uint8_t len, Schedule *entries, uint8_t maxEntries, uint8_t &count)
+{
+    count = 0;
+    if (len % 3 != 0 || len / 3 > maxEntries)
+    {
+        return false;
+    }
+
+    // Check every entry before any is written
+    for (uint8_t i = 0; i < len; i += 3)
+    {
+        if ((data[i] & 0x7F) > 6 || data[i + 1] > 23 || data[i + 2] > 59)
+        {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < len; i += 3)
+    {
+        Schedule &entry = entries[count++];
+        entry.powerState = (data[i] & 0x80) != 0;
+        entry.dow = data[i] & 0x7F;
+        entry.hour = data[i + 1];
+        entry.min = data[i + 2];
+    }
+    return true;
+}
+
+uint8_t packSchedules(const Schedule *entries, uint8_t count, uint8_t *data)
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        data[i * 3] = entries[i].dow | (entries[i].powerState ? 0x80 : 0);
+        data[i * 3 + 1] = entries[i].hour;
+        data[i * 3 + 2] = entries[i].min;
+    }
+    return count * 3;
+}
+
+ScheduleCache::ScheduleCache() : clock(0)
+{
+    memset(entries, 0, sizeof(entries));
+}
+
+void ScheduleCache::begin()
+{
+    static_assert(sizeof(Slot) <= ROW_SIZE, "Cache slot must fit a flash row");
+
+    Slot slot;
+    for (uint8_t i = 0; i < SLOTS; ++i)
+    {
+        cacheFlash.read(cacheRows + i * ROW_SIZE, &slot, sizeof(slot));
+        Entry &e = entries[i];
+        e.valid = slot.magic == SLOT_MAGIC && slot.len <= MAX_LEN && hash(slot.data, slot.len) == slot.hash;
+        e.hash = slot.hash;
+        e.lastUse = slot.stored;
+        if (e.valid && (int16_t)(slot.stored - clock) >= 0)
+        {
+            clock = slot.stored + 1;
+        }
+    }
+}
+
+uint32_t ScheduleCache::hash(const uint8_t *data, uint8_t len)
+{
+    uint32_t h = 2166136261UL;
+    for (uint8_t i = 0; i < len; ++i)
+    {
+        h ^= data[i];
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+uint32_t ScheduleCache::store(const uint8_t *data, uint8_t len)
+{
+    uint32_t h = hash(data, len);
+    int8_t found = find(h);
+    if (found >= 0)
+    {
+        entries[found].lastUse = clock++;
+        return h;
+    }
+
+    uint8_t i = victim();
+    Slot slot;
+    memset(&slot, 0xFF, sizeof(slot));
+    slot.magic = SLOT_MAGIC;
+    slot.stored = clock;
+    slot.hash = h;
+    slot.len = len;
+    memcpy(slot.data, data, len);
+
+    cacheFlash.erase(cacheRows + i * ROW_SIZE, ROW_SIZE);
+    cacheFlash.write(cacheRows + i * ROW_SIZE, &slot, sizeof(slot));
+
+    entries[i].valid = true;
+    entries[i].hash = h;
+    entries[i].lastUse = clock++;
+    return h;
+}
+
+bool ScheduleCache::load(uint32_t h, uint8_t *data, uint8_t &len)
+{
+    int8_t i = find(h);
+    if (i < 0)
+    {
+        return false;
+    }
+
+    Slot slot;
+    cacheFlash.read(cacheRows + i * ROW_SIZE, &slot, sizeof(slot));
+    len = slot.len;
+    memcpy(data, slot.data, len);
+    entries[i].lastUse = clock++;
+    return true;
+}
+
+uint8_t ScheduleCache::size() const
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < SLOTS; ++i)
+    {
+        n += entries[i].valid ? 1 : 0;
+    }
+    return n;
+}
+
+int8_t ScheduleCache::find(uint32_t h) const
+{
+    for (uint8_t i = 0; i < SLOTS; ++i)
+    {
+        if (entries[i].valid && entries[i].hash == h)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t ScheduleCache::victim() const
+{
+    uint8_t oldest = 0;
+    for (uint8_t i = 0; i < SLOTS; ++i)
+    {
+        if (!entries[i].valid)
+        {
+            return i;
+        }
+        // Ages relative to the clock, so the stamps may wrap
+        if ((uint16_t)(clock - entries[i].lastUse) > (uint16_t)(clock - entries[oldest].lastUse))
+        {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
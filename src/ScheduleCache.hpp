@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FlashStorage.h>
+#include <Schedule.hpp>
+
+/*
+ * Packed schedule entries, 3 bytes each as sent by the server:
+ *
+ *   [dow | state << 7][hour][min]
+ *
+ * Unpack into entries, false if the length or any value is invalid (nothing is then
+ * usable) or there are more than maxEntries.
+ */
+bool unpackSchedules(const uint8_t *data, uint8_t len, Schedule *entries, uint8_t maxEntries, uint8_t &count);
+
+// Pack count entries into data, 3 bytes each, returns the length
+uint8_t packSchedules(const Schedule *entries, uint8_t count, uint8_t *data);
+
+/*
+ * Schedules kept in flash keyed by the FNV-1a 32 hash of their packed entries, so the
+ * server can switch a node between programs it already holds by hash alone.
+ *
+ * Each slot is one flash row, written only when a new schedule is stored. When all
+ * slots are used the least recently used one is replaced. Use is tracked in RAM, after
+ * a reboot the order falls back to the order the schedules were stored in.
+ */
+class ScheduleCache
+{
+public:
+    static const uint8_t SLOTS = 4;
+    static const uint16_t ROW_SIZE = 256;
+    static const uint8_t MAX_LEN = 244; // Packed bytes per schedule
+
+    ScheduleCache();
+
+    // Read the slot headers from flash, call once at startup
+    void begin();
+
+    // Hash of packed entries, as the server computes it
+    static uint32_t hash(const uint8_t *data, uint8_t len);
+
+    // Store a packed schedule unless it is already cached, returns its hash
+    uint32_t store(const uint8_t *data, uint8_t len);
+
+    // Copy out the packed schedule for hash, false on a miss
+    bool load(uint32_t hash, uint8_t *data, uint8_t &len);
+
+    uint8_t size() const;
+
+private:
+    // Layout of one flash row
+    struct Slot
+    {
+        uint16_t magic;
+        uint16_t stored; // Store sequence number
+        uint32_t hash;
+        uint8_t len;
+        uint8_t pad[3];
+        uint8_t data[MAX_LEN];
+    };
+
+    struct Entry
+    {
+        bool valid;
+        uint32_t hash;
+        uint16_t lastUse;
+    };
+
+    int8_t find(uint32_t hash) const;
+    uint8_t victim() const;
+
+    Entry entries[SLOTS];
+    uint16_t clock; // Advanced on every store and load
+};
@@ -0,0 +1,279 @@
+#include <ScheduleDecoder.hpp>
+
+/*
+ * Value of one schedule field, from either encoding
+ */
+struct FieldValue
+{
+    enum
+    {
+        BOOL,
+        INT,
+        STR
+    } type;
+    bool flag;
+    int32_t num;
+    const char *str;
+    uint32_t len;
+};
+
+// Bits for the fields seen in an entry, all of them are required
+static const uint8_t FIELD_ST = 0x01;
+static const uint8_t FIELD_DOW = 0x02;
+static const uint8_t FIELD_TM = 0x04;
+static const uint8_t FIELD_ALL = FIELD_ST | FIELD_DOW | FIELD_TM;
+
+static bool keyIs(const char *key, uint32_t len, const char *name)
+{
+    return msgPackStrEquals(key, len, name);
+}
+
+static bool setField(Schedule &entry, const char *key, uint32_t keyLen, const FieldValue &v, uint8_t &seen)
+{
+    if (keyIs(key, keyLen, "st"))
+    {
+        if (v.type != FieldValue::BOOL)
+        {
+            return false;
+        }
+        entry.powerState = v.flag;
+        seen |= FIELD_ST;
+    }
+    else if (keyIs(key, keyLen, "dow"))
+    {
+        if (v.type != FieldValue::INT || v.num < 0 || v.num > 6)
+        {
+            return false;
+        }
+        entry.dow = v.num;
+        seen |= FIELD_DOW;
+    }
+    else if (keyIs(key, keyLen, "tm"))
+    {
+        // "HHMM"
+        if (v.type != FieldValue::STR || v.len != 4)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < 4; ++i)
+        {
+            if (v.str[i] < '0' || v.str[i] > '9')
+            {
+                return false;
+            }
+        }
+        entry.hour = (v.str[0] - '0') * 10 + (v.str[1] - '0');
+        entry.min = (v.str[2] - '0') * 10 + (v.str[3] - '0');
+        if (entry.hour > 23 || entry.min > 59)
+        {
+            return false;
+        }
+        seen |= FIELD_TM;
+    }
+    // Anything else is ignored so the server can add fields
+    return true;
+}
+
+static bool decodeMapEntry(MsgPackReader &rd, Schedule &entry)
+{
+    uint32_t members;
+    if (!rd.readMap(members))
+    {
+        return false;
+    }
+
+    uint8_t seen = 0;
+    for (uint32_t i = 0; i < members; ++i)
+    {
+        const char *key;
+        uint32_t keyLen;
+        if (!rd.readStr(key, keyLen))
+        {
+            return false;
+        }
+
+        FieldValue v;
+        switch (rd.peek())
+        {
+        case MsgPackReader::BOOL:
+            v.type = FieldValue::BOOL;
+            rd.readBool(v.flag);
+            break;
+        case MsgPackReader::INT:
+            v.type = FieldValue::INT;
+            rd.readInt(v.num);
+            break;
+        case MsgPackReader::STR:
+            v.type = FieldValue::STR;
+            rd.readStr(v.str, v.len);
+            break;
+        default:
+            rd.skip();
+            continue;
+        }
+
+        if (!rd.ok() || !setField(entry, key, keyLen, v, seen))
+        {
+            return false;
+        }
+    }
+    return seen == FIELD_ALL;
+}
+
+/*
+ * Minimal scanner for the flat JSON object the server puts in a string
+ */
+static void skipSpace(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    {
+        ++p;
+    }
+}
+
+static bool expect(const char *&p, const char *end, char c)
+{
+    skipSpace(p, end);
+    if (p == end || *p != c)
+    {
+        return false;
+    }
+    ++p;
+    return true;
+}
+
+static bool scanString(const char *&p, const char *end, const char *&str, uint32_t &len)
+{
+    if (!expect(p, end, '"'))
+    {
+        return false;
+    }
+    str = p;
+    while (p < end && *p != '"')
+    {
+        if (*p == '\\')
+        {
+            return false; // Escapes are never needed for schedule fields
+        }
+        ++p;
+    }
+    if (p == end)
+    {
+        return false;
+    }
+    len = p - str;
+    ++p;
+    return true;
+}
+
+static bool scanValue(const char *&p, const char *end, FieldValue &v)
+{
+    skipSpace(p, end);
+    if (p == end)
+    {
+        return false;
+    }
+
+    if (*p == '"')
+    {
+        v.type = FieldValue::STR;
+        return scanString(p, end, v.str, v.len);
+    }
+    if (end - p >= 4 && strncmp(p, "true", 4) == 0)
+    {
+        v.type = FieldValue::BOOL;
+        v.flag = true;
+        p += 4;
+        return true;
+    }
+    if (end - p >= 5 && strncmp(p, "false", 5) == 0)
+    {
+        v.type = FieldValue::BOOL;
+        v.flag = false;
+        p += 5;
+        return true;
+    }
+
+    bool negative = *p == '-';
+    if (negative)
+    {
+        ++p;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    v.type = FieldValue::INT;
+    v.num = 0;
+    while (p < end && *p >= '0' && *p <= '9' && v.num < 100000)
+    {
+        v.num = v.num * 10 + (*p++ - '0');
+    }
+    if (negative)
+    {
+        v.num = -v.num;
+    }
+    return true;
+}
+
+static bool decodeJsonEntry(MsgPackReader &rd, Schedule &entry)
+{
+    const char *p;
+    uint32_t len;
+    if (!rd.readStr(p, len))
+    {
+        return false;
+    }
+    const char *end = p + len;
+
+    if (!expect(p, end, '{'))
+    {
+        return false;
+    }
+
+    uint8_t seen = 0;
+    skipSpace(p, end);
+    if (p < end && *p == '}')
+    {
+        return false;
+    }
+    do
+    {
+        const char *key;
+        uint32_t keyLen;
+        FieldValue v;
+        if (!scanString(p, end, key, keyLen) || !expect(p, end, ':') || !scanValue(p, end, v))
+        {
+            return false;
+        }
+        if (!setField(entry, key, keyLen, v, seen))
+        {
+            return false;
+        }
+        skipSpace(p, end);
+    } while (p < end && *p == ',' && ++p);
+
+    return expect(p, end, '}') && seen == FIELD_ALL;
+}
+
+bool decodeScheduleList(MsgPackReader &rd, Schedule *entries, uint8_t maxEntries, uint8_t &count)
+{
+    count = 0;
+
+    uint32_t elements;
+    if (!rd.readArray(elements) || elements > maxEntries)
+    {
+        return false;
+    }
+
+    for (; count < elements; ++count)
+    {
+        bool decoded = rd.peek() == MsgPackReader::STR ? decodeJsonEntry(rd, entries[count])
+                                                       : decodeMapEntry(rd, entries[count]);
+        if (!decoded)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+#include <MsgPackReader.hpp>
+#include <Schedule.hpp>
+
+/*
+ * Decode the "cmd-data" schedule list of an init command straight into entries.
+ * Each element is either a map or a string holding the JSON object, as the server sends it:
+ *
+ *   {"st": true, "dow": 1, "tm": "0730"}
+ *
+ * count is set to the number of entries decoded. False if the list is malformed or
+ * longer than maxEntries, the entries are then only partly written.
+ */
+bool decodeScheduleList(MsgPackReader &rd, Schedule *entries, uint8_t maxEntries, uint8_t &count);
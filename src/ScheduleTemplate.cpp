@@ -0,0 +1,205 @@
+#include <ScheduleTemplate.hpp>
+
+// Day of week bits, Sunday is day 0
+static const uint8_t DAYS_ALL = 0x7F;
+static const uint8_t DAYS_WEEKDAY = 0x3E;
+static const uint8_t DAYS_WEEKEND = 0x41;
+static const uint8_t DAYS_MON_SAT = 0x7E;
+
+// Rule start / duration taken from the command parameters
+static const uint16_t PARAM = 0xFFFF;
+
+static const uint16_t DEFAULT_START = 6 * 60;
+static const uint16_t DEFAULT_DURATION = 60;
+static const uint16_t MINUTES_PER_DAY = 24 * 60;
+
+struct TemplateRule
+{
+    uint8_t days;
+    uint16_t start;    // Minute of the day, or PARAM
+    uint16_t duration; // Minutes, or PARAM
+};
+
+struct ScheduleTemplate
+{
+    static const uint8_t MAX_RULES = 2;
+
+    uint8_t id;
+    uint8_t ruleCount;
+    TemplateRule rules[MAX_RULES];
+};
+
+static const ScheduleTemplate TEMPLATES[] = {
+    {0, 0, {}},                                                                    // Always off
+    {1, 1, {{DAYS_ALL, PARAM, PARAM}}},                                            // Daily pre-heat
+    {2, 1, {{DAYS_WEEKDAY, PARAM, PARAM}}},                                        // Weekday pre-heat
+    {3, 1, {{DAYS_WEEKEND, PARAM, PARAM}}},                                        // Weekend pre-heat
+    {4, 1, {{DAYS_MON_SAT, PARAM, PARAM}}},                                        // Monday to Saturday pre-heat
+    {5, 2, {{DAYS_WEEKDAY, PARAM, PARAM}, {DAYS_WEEKEND, 8 * 60, PARAM}}},         // Weekdays, weekends at 08:00
+    {6, 2, {{DAYS_WEEKDAY, PARAM, PARAM}, {DAYS_WEEKDAY, 16 * 60 + 30, PARAM}}},   // Weekdays, again at 16:30
+};
+
+static const uint32_t MINUTES_PER_WEEK = 7UL * MINUTES_PER_DAY;
+
+// Start or end of an on period, in minutes from the start of the week
+struct Edge
+{
+    uint16_t at;
+    bool on;
+};
+
+static void addEdges(Edge *edges, uint8_t &edgeCount, uint8_t &wrapped, uint16_t dow, uint16_t start, uint16_t duration)
+{
+    uint32_t from = (uint32_t)dow * MINUTES_PER_DAY + start;
+    uint32_t to = from + duration;
+    if (to > MINUTES_PER_WEEK)
+    {
+        // Runs past the end of the week, so it is already on when the week starts
+        to -= MINUTES_PER_WEEK;
+        ++wrapped;
+    }
+    edges[edgeCount].at = from;
+    edges[edgeCount++].on = true;
+    edges[edgeCount].at = to;
+    edges[edgeCount++].on = false;
+}
+
+static bool addEntry(Schedule *entries, uint8_t maxEntries, uint8_t &count, uint16_t at, bool on)
+{
+    if (count == maxEntries)
+    {
+        return false;
+    }
+    Schedule &entry = entries[count++];
+    entry.powerState = on;
+    entry.dow = at / MINUTES_PER_DAY;
+    entry.hour = at % MINUTES_PER_DAY / 60;
+    entry.min = at % 60;
+    return true;
+}
+
+/*
+ * An entry only counts within its own hour, so an on period needs an on entry where it
+ * starts and at the top of every later hour it covers. With no entry for an hour power is
+ * off, so an off entry is only needed where the period ends part way into an hour.
+ */
+static bool addPeriod(Schedule *entries, uint8_t maxEntries, uint8_t &count, uint16_t from, uint16_t to)
+{
+    if (!addEntry(entries, maxEntries, count, from, true))
+    {
+        return false;
+    }
+    for (uint16_t hour = (from / 60 + 1) * 60; hour < to; hour += 60)
+    {
+        if (!addEntry(entries, maxEntries, count, hour, true))
+        {
+            return false;
+        }
+    }
+    return to % 60 == 0 || addEntry(entries, maxEntries, count, to, false);
+}
+
+/*
+ * Merge the on periods and write their entries in week order. Starts sort before ends at
+ * the same minute, so back to back periods do not switch off in between.
+ */
+static bool addEntries(Edge *edges, uint8_t edgeCount, uint8_t wrapped, Schedule *entries, uint8_t maxEntries, uint8_t &count)
+{
+    for (uint8_t i = 1; i < edgeCount; ++i)
+    {
+        Edge edge = edges[i];
+        uint8_t j = i;
+        for (; j > 0 && (edges[j - 1].at > edge.at || (edges[j - 1].at == edge.at && !edges[j - 1].on && edge.on)); --j)
+        {
+            edges[j] = edges[j - 1];
+        }
+        edges[j] = edge;
+    }
+
+    // A period wrapped past the end of the week is already on from its start
+    uint8_t active = wrapped;
+    uint16_t from = 0;
+    for (uint8_t i = 0; i < edgeCount; ++i)
+    {
+        bool wasOn = active > 0;
+        active = edges[i].on ? active + 1 : active - 1;
+        if (wasOn == (active > 0))
+        {
+            continue;
+        }
+        if (active > 0)
+        {
+            from = edges[i].at;
+        }
+        else if (!addPeriod(entries, maxEntries, count, from, edges[i].at))
+        {
+            return false;
+        }
+    }
+    return active == 0 || addPeriod(entries, maxEntries, count, from, MINUTES_PER_WEEK);
+}
+
+TemplateResult expandTemplate(const uint8_t *args, uint8_t len, Schedule *entries, uint8_t maxEntries, uint8_t &count)
+{
+    count = 0;
+    if (len != 1 && len != 3 && len != 4)
+    {
+        return TEMPLATE_BAD_VALUE;
+    }
+
+    const ScheduleTemplate *tmpl = NULL;
+    for (uint8_t i = 0; i < sizeof(TEMPLATES) / sizeof(TEMPLATES[0]); ++i)
+    {
+        if (TEMPLATES[i].id == args[0])
+        {
+            tmpl = &TEMPLATES[i];
+            break;
+        }
+    }
+    if (tmpl == NULL)
+    {
+        return TEMPLATE_UNKNOWN;
+    }
+
+    uint16_t start = DEFAULT_START;
+    uint16_t duration = DEFAULT_DURATION;
+    if (len >= 3)
+    {
+        if (args[1] > 23 || args[2] > 59)
+        {
+            return TEMPLATE_BAD_VALUE;
+        }
+        start = args[1] * 60 + args[2];
+    }
+    if (len == 4)
+    {
+        if (args[3] == 0)
+        {
+            return TEMPLATE_BAD_VALUE;
+        }
+        duration = args[3];
+    }
+
+    Edge edges[2 * 7 * ScheduleTemplate::MAX_RULES]; // A start and an end per rule and day
+    uint8_t edgeCount = 0;
+    uint8_t wrapped = 0;
+    for (uint8_t r = 0; r < tmpl->ruleCount; ++r)
+    {
+        const TemplateRule &rule = tmpl->rules[r];
+        for (uint8_t dow = 0; dow < 7; ++dow)
+        {
+            if ((rule.days & (1 << dow)) == 0)
+            {
+                continue;
+            }
+            uint16_t ruleStart = rule.start == PARAM ? start : rule.start;
+            uint16_t ruleDuration = rule.duration == PARAM ? duration : rule.duration;
+            addEdges(edges, edgeCount, wrapped, dow, ruleStart, ruleDuration);
+        }
+    }
+    if (!addEntries(edges, edgeCount, wrapped, entries, maxEntries, count))
+    {
+        return TEMPLATE_TOO_LARGE;
+    }
+    return TEMPLATE_OK;
+}
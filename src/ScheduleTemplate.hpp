@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Schedule.hpp>
+
+/*
+ * Library of standard power programs kept in flash, selected by ID and expanded into
+ * schedule entries on the device so the server only has to send a few bytes:
+ *
+ *   [template id]                               start and duration default to 06:00 / 60 min
+ *   [template id][start hour][start min]        default 60 min
+ *   [template id][start hour][start min][duration min]
+ *
+ * An entry only applies within its own hour (see checkSchedules), so each on period is an
+ * "on" entry where it starts and at the top of every further hour it covers, and an
+ * "off" entry where it ends part way into an hour. Overlapping periods are merged, and
+ * periods may run past midnight into the next day. Long periods on many days can need
+ * more entries than the table holds, those are refused.
+ */
+enum TemplateResult
+{
+    TEMPLATE_OK,
+    TEMPLATE_UNKNOWN,   // No template with this ID
+    TEMPLATE_BAD_VALUE, // Parameters out of range
+    TEMPLATE_TOO_LARGE  // Expands to more than maxEntries
+};
+
+/*
+ * Expand the template selected by args, laid out as above, into entries. count is the
+ * number written, only valid on TEMPLATE_OK.
+ */
+TemplateResult expandTemplate(const uint8_t *args, uint8_t len, Schedule *entries, uint8_t maxEntries, uint8_t &count);
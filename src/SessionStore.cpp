@@ -0,0 +1,59 @@
+#include <SessionStore.hpp>
+
+static_assert(sizeof(LoraSession) <= Journal::MAX_LEN, "LoraSession does not fit a journal record");
+
+// Layout of the JOURNAL_FCNT record
+struct CounterRecord
+{
+    uint32_t devAddr; // Session the counters belong to
+    uint32_t seqnoUp;
+    uint32_t seqnoDn;
+};
+
+SessionStore::SessionStore(Journal &journal) : journal(journal)
+{
+}
+
+bool SessionStore::load(LoraSession &session)
+{
+    uint8_t buf[Journal::MAX_LEN];
+    uint8_t len;
+    if (!journal.load(JOURNAL_SESSION, buf, sizeof(buf), len) || len != sizeof(session))
+    {
+        return false;
+    }
+    memcpy(&session, buf, sizeof(session));
+
+    // Counters saved since the join, unless they are from an older session
+    CounterRecord counters;
+    if (!journal.load(JOURNAL_FCNT, buf, sizeof(buf), len) || len != sizeof(counters))
+    {
+        return true;
+    }
+    memcpy(&counters, buf, sizeof(counters));
+    if (counters.devAddr == session.devAddr && (int32_t)(counters.seqnoUp - session.seqnoUp) > 0)
+    {
+        session.seqnoUp = counters.seqnoUp;
+        session.seqnoDn = counters.seqnoDn;
+    }
+    return true;
+}
+
+void SessionStore::save(const LoraSession &session)
+{
+    journal.append(JOURNAL_SESSION, &session, sizeof(session));
+}
+
+void SessionStore::saveCounters(const LoraSession &session)
+{
+    CounterRecord counters;
+    counters.devAddr = session.devAddr;
+    counters.seqnoUp = session.seqnoUp;
+    counters.seqnoDn = session.seqnoDn;
+    journal.append(JOURNAL_FCNT, &counters, sizeof(counters));
+}
+
+void SessionStore::clear()
+{
+    journal.append(JOURNAL_SESSION, "", 0);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Journal.hpp>
+
+/*
+ * LoRaWAN session from an OTAA join, enough to carry on after a reboot without joining again
+ */
+struct LoraSession
+{
+    static const uint8_t CHANNEL_BYTES = 9; // US915 has 72 uplink channels
+
+    uint32_t netId;
+    uint32_t devAddr;
+    uint8_t nwkKey[16];
+    uint8_t appKey[16];
+    uint32_t seqnoUp; // Next FCntUp, or higher
+    uint32_t seqnoDn; // Next FCntDown expected
+    uint8_t datarate;
+    uint8_t channels[CHANNEL_BYTES]; // Enabled channel bitmap, channel 0 in bit 0 of byte 0
+    uint8_t rxDelay;                 // RX1 delay in seconds, from the join accept
+    uint8_t rx1DrOffset;             // RX1 data rate offset, from the join accept
+    uint8_t dn2Dr;                   // RX2 data rate
+    uint32_t dn2Freq;                // RX2 frequency in Hz
+};
+
+/*
+ * The session held in the journal. The keys are written on a join, the frame counters
+ * on their own as a small record.
+ *
+ * Counters are still not saved on every uplink: callers save them every FCNT_SAVE_STEP
+ * uplinks and restore the up counter that far ahead, so a counter value is never sent
+ * twice in the same session.
+ */
+class SessionStore
+{
+public:
+    static const uint32_t FCNT_SAVE_STEP = 8;
+
+    SessionStore(Journal &journal);
+
+    // False if there is no valid session stored
+    bool load(LoraSession &session);
+
+    void save(const LoraSession &session);
+
+    // Save just the frame counters of the stored session
+    void saveCounters(const LoraSession &session);
+
+    // Forget the stored session, the next boot joins again
+    void clear();
+
+private:
+    Journal &journal;
+};
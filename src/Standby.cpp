@@ -0,0 +1,21 @@
+#include <Standby.hpp>
+
+static uint32_t sleptMs = 0;
+
+uint32_t standbySleep(RTCZero &rtc, uint32_t seconds)
+{
+    uint32_t start = rtc.getEpoch();
+    rtc.setAlarmEpoch(start + seconds);
+    rtc.enableAlarm(rtc.MATCH_YYMMDDHHMMSS);
+    rtc.standbyMode();
+    rtc.disableAlarm();
+
+    uint32_t slept = rtc.getEpoch() - start;
+    sleptMs += slept * 1000;
+    return slept;
+}
+
+uint32_t standbyMs()
+{
+    return sleptMs;
+}
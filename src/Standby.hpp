@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+#include <RTCZero.h>
+
+/*
+ * Put the SAMD21 in standby for up to seconds, woken by an RTC alarm or any other enabled
+ * interrupt. Returns the whole seconds slept, by the RTC.
+ *
+ * The SysTick stops in standby, so millis() / micros() and with them the LMIC clock do
+ * not count the time asleep. The time slept is kept here instead, add standbyMs() to
+ * millis() for the time since boot. It is only good to a second, the RTC count.
+ */
+uint32_t standbySleep(RTCZero &rtc, uint32_t seconds);
+
+// Total time slept since boot
+uint32_t standbyMs();
@@ -0,0 +1,138 @@
+#include <TransitionLog.hpp>
+
+TransitionLog::TransitionLog()
+    : head(0), count(0), dropped(0), base(0), flushRequested(false)
+{
+}
+
+void TransitionLog::record(uint32_t epoch, uint8_t channel, bool state)
+{
+    uint32_t minute = epoch - (epoch % 60);
+
+    if (count == 0)
+    {
+        base = minute;
+    }
+    else if (minute < base)
+    {
+        // The RTC stepped back, move the base down to the new minute. If the older
+        // entries can no longer be reached from there, clamp to the base instead.
+        uint32_t shift = (base - minute) / 60;
+        if (shift + maxDelta() > 0xFFFF)
+        {
+            minute = base;
+        }
+        else
+        {
+            for (uint8_t i = 0; i < count; ++i)
+            {
+                ring[(head + i) % CAPACITY].delta += shift;
+            }
+            base = minute;
+        }
+    }
+
+    // Entries too old to be reached by a 16 bit delta, or no room left, lose the oldest
+    while (count > 0 && (count == CAPACITY || (minute - base) / 60 > 0xFFFF))
+    {
+        dropOldest();
+        if (count == 0)
+        {
+            base = minute;
+        }
+    }
+
+    Entry &e = ring[(head + count) % CAPACITY];
+    e.delta = (uint16_t)((minute - base) / 60);
+    e.chanState = (uint8_t)((channel << 1) | (state ? 1 : 0));
+    ++count;
+}
+
+size_t TransitionLog::encode(uint8_t *buf, size_t maxLen, uint8_t &entries) const
+{
+    entries = 0;
+    if (maxLen < HEADER_LEN + ENTRY_LEN)
+    {
+        return 0;
+    }
+
+    buf[0] = base & 0xFF;
+    buf[1] = (base >> 8) & 0xFF;
+    buf[2] = (base >> 16) & 0xFF;
+    buf[3] = (base >> 24) & 0xFF;
+    buf[4] = dropped;
+
+    size_t len = HEADER_LEN;
+    while (entries < count && len + ENTRY_LEN <= maxLen)
+    {
+        const Entry &e = ring[(head + entries) % CAPACITY];
+        buf[len++] = e.delta & 0xFF;
+        buf[len++] = e.delta >> 8;
+        buf[len++] = e.chanState;
+        ++entries;
+    }
+
+    return len;
+}
+
+void TransitionLog::commit(uint8_t entries)
+{
+    if (entries > count)
+    {
+        entries = count;
+    }
+
+    head = (head + entries) % CAPACITY;
+    count -= entries;
+    dropped = 0;
+
+    if (count == 0)
+    {
+        flushRequested = false;
+        return;
+    }
+
+    // Move the base up to the earliest remaining entry so the deltas stay small. After
+    // the RTC stepped back that is not necessarily the oldest one.
+    uint16_t shift = 0xFFFF;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint16_t delta = ring[(head + i) % CAPACITY].delta;
+        if (delta < shift)
+        {
+            shift = delta;
+        }
+    }
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        ring[(head + i) % CAPACITY].delta -= shift;
+    }
+    base += (uint32_t)shift * 60;
+}
+
+void TransitionLog::dropOldest()
+{
+    if (dropped < 0xFF)
+    {
+        ++dropped;
+    }
+
+    // Reuse commit() for the rebase but keep the drop count for the next frame
+    uint8_t keep = dropped;
+    commit(1);
+    dropped = keep;
+}
+
+uint16_t TransitionLog::maxDelta() const
+{
+    uint16_t max = 0;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint16_t delta = ring[(head + i) % CAPACITY].delta;
+        if (delta > max)
+        {
+            max = delta;
+        }
+    }
+    return max;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Ring buffer of timestamped power relay transitions.
+ *
+ * Every change of a power relay is recorded with a 16 bit minute offset from the
+ * base time of the buffer, so short ON/OFF pulses and the exact switch times are
+ * preserved between status updates. Entries are packed several per frame:
+ *
+ *   Frame: [base epoch, u4 LE][dropped count, u1][entry]...
+ *   Entry: [minute delta from base, u2 LE][channel << 1 | state]
+ */
+class TransitionLog
+{
+public:
+    static const uint8_t CAPACITY = 32;
+    static const uint8_t FLUSH_LEVEL = 24; // Flush before the buffer fills and we start dropping
+    static const uint8_t HEADER_LEN = 5;
+    static const uint8_t ENTRY_LEN = 3;
+
+    TransitionLog();
+
+    void record(uint32_t epoch, uint8_t channel, bool state);
+
+    // Ask for the buffer to be sent with the next free uplink, i.e. on the heartbeat
+    void requestFlush() { flushRequested = true; }
+    bool flushPending() const { return count > 0 && (flushRequested || count >= FLUSH_LEVEL); }
+    uint8_t size() const { return count; }
+
+    // Pack as many of the oldest entries as fit in maxLen, entries is set to the number packed
+    size_t encode(uint8_t *buf, size_t maxLen, uint8_t &entries) const;
+
+    // The packed entries were handed to the radio, release them
+    void commit(uint8_t entries);
+
+private:
+    struct Entry
+    {
+        uint16_t delta;
+        uint8_t chanState;
+    };
+
+    void dropOldest();
+    uint16_t maxDelta() const;
+
+    Entry ring[CAPACITY];
+    uint8_t head;
+    uint8_t count;
+    uint8_t dropped;
+    uint32_t base; // Epoch of the earliest entry, on a minute boundary
+    bool flushRequested;
+};
@@ -0,0 +1,110 @@
+#include <UplinkQueue.hpp>
+
+UplinkQueue::UplinkQueue(const MsgPolicy *policyTable)
+    : policies(policyTable), count(0)
+{
+}
+
+UplinkFrame *UplinkQueue::add(MsgType type, uint8_t port)
+{
+    if (full())
+    {
+        return NULL;
+    }
+
+    UplinkFrame *frame = &frames[count++];
+    frame->type = type;
+    frame->port = port;
+    frame->len = 0;
+    frame->inFlight = false;
+    frame->notBefore = 0;
+    return frame;
+}
+
+UplinkFrame *UplinkQueue::nextReady(uint32_t now)
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (frames[i].inFlight)
+        {
+            return NULL;
+        }
+        if (frames[i].notBefore <= now)
+        {
+            return &frames[i];
+        }
+    }
+    return NULL;
+}
+
+void UplinkQueue::remove(UplinkFrame *frame)
+{
+    uint8_t i = frame - frames;
+    if (i >= count)
+    {
+        return;
+    }
+
+    // Keep the frames in order, the queue is short so moving them is cheap enough
+    for (; i + 1 < count; ++i)
+    {
+        frames[i].type = frames[i + 1].type;
+        frames[i].port = frames[i + 1].port;
+        frames[i].len = frames[i + 1].len;
+        frames[i].inFlight = frames[i + 1].inFlight;
+        frames[i].notBefore = frames[i + 1].notBefore;
+        memcpy(frames[i].data, frames[i + 1].data, frames[i + 1].len);
+    }
+    --count;
+}
+
+bool UplinkQueue::holds(MsgType type) const
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (frames[i].type == type)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+UplinkFrame *UplinkQueue::inFlight()
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (frames[i].inFlight)
+        {
+            return &frames[i];
+        }
+    }
+    return NULL;
+}
+
+TxOutcome UplinkQueue::txComplete(bool acked, MsgType &type)
+{
+    UplinkFrame *frame = inFlight();
+    if (frame == NULL)
+    {
+        return TX_NONE;
+    }
+
+    type = frame->type;
+    bool confirmed = policy(*frame).confirmed;
+    remove(frame);
+    if (!confirmed)
+    {
+        return TX_SENT;
+    }
+    return acked ? TX_ACKED : TX_FAILED;
+}
+
+void UplinkQueue::cancel()
+{
+    UplinkFrame *frame = inFlight();
+    if (frame != NULL)
+    {
+        frame->inFlight = false;
+    }
+}
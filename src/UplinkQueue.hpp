@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+#include <AirtimeLedger.hpp>
+
+/*
+ * Kinds of uplink message, each has an entry in the policy table
+ */
+enum MsgType
+{
+    MSG_START,    // Startup request, asks the server for the schedule and time
+    MSG_STATUS,   // Periodic power state heartbeat
+    MSG_HISTORY,  // Batched power transitions
+    MSG_RESPONSE, // Result of a downlink command
+    MSG_TYPES
+};
+
+/*
+ * How a kind of message is sent
+ *   confirmed - ask the network for an ack (TXRX_ACK / TXRX_NACK). LMIC retransmits a
+ *               confirmed frame until it is acked, up to 8 times, so it is not queued again.
+ */
+struct MsgPolicy
+{
+    MsgPriority priority;
+    bool confirmed;
+};
+
+struct UplinkFrame
+{
+    static const uint8_t MAX_LEN = 242; // Largest US915 application payload
+
+    MsgType type;
+    uint8_t port;
+    uint8_t len;
+    bool inFlight;
+    uint32_t notBefore; // Epoch before which the frame is not sent
+    uint8_t data[MAX_LEN];
+};
+
+enum TxOutcome
+{
+    TX_NONE,   // No message of ours was in flight
+    TX_SENT,   // Unconfirmed message sent
+    TX_ACKED,  // Confirmed message acknowledged
+    TX_FAILED  // Confirmed message not acknowledged
+};
+
+/*
+ * Frames waiting to be sent or acknowledged, oldest first. One frame is in flight at a time.
+ */
+class UplinkQueue
+{
+public:
+    static const uint8_t CAPACITY = 4;
+
+    explicit UplinkQueue(const MsgPolicy *policyTable);
+
+    const MsgPolicy &policy(const UplinkFrame &frame) const { return policies[frame.type]; }
+
+    // Reserve the next frame for a message, fill in data and len. NULL if the queue is full
+    UplinkFrame *add(MsgType type, uint8_t port);
+
+    // Oldest frame that may be sent now, NULL if none
+    UplinkFrame *nextReady(uint32_t now);
+
+    // The frame was handed to the radio
+    void sent(UplinkFrame *frame) { frame->inFlight = true; }
+
+    // Hold a frame back until the given time
+    void defer(UplinkFrame *frame, uint32_t until) { frame->notBefore = until; }
+
+    void remove(UplinkFrame *frame);
+
+    // Record the result of the frame in flight, type is set to the message type it carried
+    TxOutcome txComplete(bool acked, MsgType &type);
+
+    // The frame in flight was not sent after all, it goes out again
+    void cancel();
+
+    // A frame of this type is queued or in flight
+    bool holds(MsgType type) const;
+
+    bool full() const { return count == CAPACITY; }
+    uint8_t size() const { return count; }
+
+private:
+    UplinkFrame *inFlight();
+
+    const MsgPolicy *policies;
+    UplinkFrame frames[CAPACITY];
+    uint8_t count;
+};
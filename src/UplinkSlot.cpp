@@ -0,0 +1,23 @@
+#include <UplinkSlot.hpp>
+
+uint16_t uplinkSlot(const uint8_t *eui, uint8_t len, uint16_t period)
+{
+    uint32_t hash = 2166136261UL;
+    for (uint8_t i = 0; i < len; ++i)
+    {
+        hash ^= eui[i];
+        hash *= 16777619UL;
+    }
+    return hash % period;
+}
+
+uint32_t secondsToSlot(uint32_t epoch, uint16_t slot, uint16_t interval)
+{
+    uint32_t into = (epoch + interval - slot % interval) % interval;
+    return interval - into;
+}
+
+uint32_t slotPeriod(uint32_t epoch, uint16_t slot, uint16_t period)
+{
+    return (epoch + period - slot) / period;
+}
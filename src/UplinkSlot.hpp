@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Deterministic transmit slot for this node within a reporting period, taken from a hash
+ * (FNV-1a) of the DevEUI. Nodes that power up together still report at different times.
+ */
+uint16_t uplinkSlot(const uint8_t *eui, uint8_t len, uint16_t period);
+
+/*
+ * Seconds from epoch until the next time that is slot seconds past a multiple of
+ * interval, 1 - interval. Used to keep a periodic job on the node's own grid.
+ */
+uint32_t secondsToSlot(uint32_t epoch, uint16_t slot, uint16_t interval);
+
+/*
+ * Number of the reporting period epoch falls in, periods start slot seconds past a
+ * multiple of period. Changes exactly once per period at the node's slot.
+ */
+uint32_t slotPeriod(uint32_t epoch, uint16_t slot, uint16_t period);
@@ -0,0 +1,64 @@
+#include <WarmStore.hpp>
+#include <Crc.hpp>
+
+static const uint16_t WARM_MAGIC = 0x574D;
+
+// Layout of the no-init record
+struct WarmRecord
+{
+    uint16_t magic;
+    uint16_t layout; // Of the firmware that saved it
+    uint16_t len;
+    uint16_t crc; // CRC-16/CCITT of the first len bytes of data
+    uint8_t restarts; // Loads since the last settled(), kept by save()
+    uint8_t data[WarmStore::CAPACITY];
+};
+
+__attribute__((section(".noinit"))) static WarmRecord record;
+
+WarmStore::WarmStore(uint16_t layout) : layout(layout)
+{
+}
+
+bool WarmStore::load(void *state, size_t len)
+{
+    if (record.magic != WARM_MAGIC || record.layout != layout || record.len != len || len > CAPACITY ||
+        crc16(record.data, len) != record.crc)
+    {
+        return false;
+    }
+    if (record.restarts >= MAX_RESTARTS)
+    {
+        return false;
+    }
+    ++record.restarts;
+    memcpy(state, record.data, len);
+    return true;
+}
+
+void WarmStore::save(const void *state, size_t len)
+{
+    if (len > CAPACITY)
+    {
+        return;
+    }
+
+    // Never valid while half written
+    record.magic = 0;
+    memcpy(record.data, state, len);
+    record.layout = layout;
+    record.len = len;
+    record.crc = crc16(record.data, len);
+    record.magic = WARM_MAGIC;
+}
+
+void WarmStore::clear()
+{
+    record.magic = 0;
+    record.restarts = 0;
+}
+
+void WarmStore::settled()
+{
+    record.restarts = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * State kept in RAM the startup code does not clear (.noinit, placed by noinit.ld), so it
+ * survives a watchdog or software reset but not a power loss. Stored with its length and
+ * a CRC, so power on garbage is not taken for state, and with the layout id given by the
+ * caller, so neither is state of the same length saved by other firmware.
+ */
+class WarmStore
+{
+public:
+    static const size_t CAPACITY = 640;
+    static const uint8_t MAX_RESTARTS = 3; // Warm restarts in a row before the state is dropped
+
+    // layout identifies the layout of the state, it should change with every build
+    explicit WarmStore(uint16_t layout);
+
+    // False if there is no valid state of len bytes, or it has already been taken back
+    // MAX_RESTARTS times without settled() in between: state that keeps the node
+    // crashing is not handed back for ever
+    bool load(void *state, size_t len);
+
+    void save(const void *state, size_t len);
+
+    void clear();
+
+    // The node has run long enough since the last restart for its state to be trusted
+    void settled();
+
+private:
+    uint16_t layout;
+};
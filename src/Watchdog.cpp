@@ -0,0 +1,38 @@
+#include <Watchdog.hpp>
+
+static const uint8_t PERIOD_16K_CYCLES = 0xB; // 16 s at 1.024 kHz
+
+static void sync()
+{
+    while (WDT->STATUS.bit.SYNCBUSY)
+        ;
+}
+
+void watchdogStart()
+{
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_WDT | GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK2;
+    while (GCLK->STATUS.bit.SYNCBUSY)
+        ;
+
+    sync();
+    WDT->CTRL.reg = 0;
+    sync();
+    WDT->CONFIG.reg = WDT_CONFIG_PER(PERIOD_16K_CYCLES);
+    WDT->CTRL.reg = WDT_CTRL_ENABLE;
+    sync();
+}
+
+void watchdogStop()
+{
+    sync();
+    WDT->CTRL.reg = 0;
+    sync();
+}
+
+void watchdogFeed()
+{
+    if (!WDT->STATUS.bit.SYNCBUSY)
+    {
+        WDT->CLEAR.reg = WDT_CLEAR_CLEAR_KEY;
+    }
+}
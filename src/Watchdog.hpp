@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * SAMD21 watchdog, resets the chip when it is not fed for WATCHDOG_SEC. It runs from
+ * generic clock 2, the 1.024 kHz clock RTCZero sets up, so start it after rtc.begin().
+ */
+const uint8_t WATCHDOG_SEC = 16;
+
+void watchdogStart();
+
+// Stop it, e.g. for a standby sleep longer than the timeout
+void watchdogStop();
+
+// Restart the timeout. Does not wait, skipped while the last write is still syncing.
+void watchdogFeed();
@@ -4,18 +4,53 @@
 #include <hal/hal.h>
 #include <ArduinoJson.h>
 #include <Schedule.hpp>
+#include <TransitionLog.hpp>
+#include <PayloadBudget.hpp>
+#include <Fragmenter.hpp>
+#include <AirtimeLedger.hpp>
+#include <UplinkSlot.hpp>
+#include <UplinkQueue.hpp>
+#include <Downlink.hpp>
+#include <MsgPackReader.hpp>
+#include <ScheduleDecoder.hpp>
+#include <ScheduleTemplate.hpp>
+#include <ScheduleCache.hpp>
+#include <CommandTable.hpp>
+#include <FrameDecoder.hpp>
+#include <RuntimeConfig.hpp>
+#include <RelayOverride.hpp>
+#include <SessionStore.hpp>
+#include <LinkMonitor.hpp>
+#include <LinkQuality.hpp>
+#include <Standby.hpp>
+#include <BootTimer.hpp>
+#include <Watchdog.hpp>
+#include <WarmStore.hpp>
+#include <Crc.hpp>
+#include <Journal.hpp>
+#include <RadioRx.hpp>
 
 /*
- * Allow logging to be turned on / off
+ * Allow logging to be turned on / off, the default until the runtime configuration is loaded.
+ * On by default: it costs nothing without a terminal on the USB port, and the node still
+ * sleeps then, see canSleep.
  */
 const boolean LOGGING_ENABLED = true;
-#define logMsg(M) (LOGGING_ENABLED == true ? SerialUSB.print(M) : false)
+#define logMsg(M) (config.logging == true ? SerialUSB.print(M) : false)
 
 /*
  * Real Time Clock for the SAM21 / Zero
  */
 RTCZero rtc;
 
+/*
+ * Milliseconds since boot, counting time in standby where millis() stops, see idleCheck
+ */
+u_int32_t uptimeMs()
+{
+    return millis() + standbyMs();
+}
+
 // This EUI must be in little-endian format, so least-significant-byte
 // first. When copying an EUI from ttnctl output, this means to reverse
 // the bytes. For TTN issued EUIs the last bytes should be 0xD5, 0xB3,
@@ -40,18 +75,268 @@ void os_getDevKey(u1_t *buf) { memcpy_P(buf, APPKEY, 16); }
 static osjob_t statusJob;
 
 /*
- * Command uplink queue and structure
+ * Job that processes received downlinks, and the queue they wait in
+ */
+static osjob_t downlinkJob;
+static InboundQueue inbound;
+
+/*
+ * Downlink duplicate detection. The FCntDown of the last frame catches the network
+ * repeating a confirmed downlink, the "seq" of the last init catches the server
+ * resending a command. Either way the command is not applied a second time, which
+ * would set the RTC back to a stale time.
+ */
+static u_int32_t lastFCntDown = 0;
+static boolean fcntSeen = false;
+static u_int32_t lastInitSeq = 0;
+static boolean initSeqSeen = false;
+
+/*
+ * Class C: mains powered nodes can keep the radio listening on RX2 between uplinks, so
+ * commands arrive within a second or so instead of after the next uplink. LMIC has no
+ * Class C support, frames are received and decoded alongside the multicast group below.
+ * Enable with -D CLASS_C=1 in build_flags.
+ */
+#ifndef CLASS_C
+#define CLASS_C 0
+#endif
+
+/*
+ * Class B: track the gateway beacons and open a ping slot every 2^CLASS_B_PING_EXP
+ * seconds, for bounded downlink latency at a fraction of the Class C power. The beacons
+ * also carry GPS time for the RTC. Enable with -D CLASS_B=1.
+ */
+#ifndef CLASS_B
+#define CLASS_B 0
+#endif
+#ifndef CLASS_B_PING_EXP
+#define CLASS_B_PING_EXP 5
+#endif
+#if CLASS_B && CLASS_C
+#error "CLASS_B and CLASS_C cannot both be enabled"
+#endif
+#if CLASS_B_PING_EXP > 7
+#error "CLASS_B_PING_EXP must be 0 - 7"
+#endif
+
+#if CLASS_B
+static osjob_t beaconJob;
+const unsigned BEACON_RETRY_SEC = 300; // Wait before scanning again after losing the beacon
+#endif
+
+/*
+ * Multicast group session, provisioned with OP_GROUP_SET. LMIC only accepts frames for
+ * its own DevAddr, so while LMIC is idle the radio is left listening on RX2 and group
+ * frames are checked and decrypted here, see FrameDecoder. Group commands are applied
+ * like unicast ones, a later unicast command still overrides them on this node.
+ */
+static FrameSession groupSession;
+static boolean groupActive = false;
+static boolean listening = false;
+static osjob_t listenJob;
+
+/*
+ * While listening the radio is polled for frames by rxPollJob, see RadioRx
+ */
+const u_int32_t RX_POLL_MS = 20;
+static osjob_t rxPollJob;
+static u_int8_t rxFrame[MAX_LEN_FRAME];
+
+/*
+ * Device state kept in flash: config, session, frame counters, relay state and schedules.
+ * Replayed at boot, relays and schedules are written by persistJob when they change.
+ */
+static Journal journal;
+static osjob_t persistJob;
+
+/*
+ * LoRaWAN session saved after a join and restored at boot, so a reboot does not cost
+ * a join. If the startup request is never acked on a restored session the network has
+ * dropped it, the saved session is then forgotten and the node joins again.
+ */
+static SessionStore sessionStore(journal);
+static LoraSession session;
+static boolean sessionRestored = false;
+static osjob_t sessionJob;
+
+/*
+ * Connectivity state. While offline no uplinks are sent, the schedules keep running from
+ * local state and rejoins are attempted with a backoff by linkJob.
+ */
+static LinkMonitor linkMonitor;
+static osjob_t linkJob;
+
+/*
+ * RSSI / SNR and ack loss averages, sets the data rate when ADR is turned off
+ */
+static LinkQuality quality;
+
+/*
+ * Longest time spent in the LMIC event callback, anything slow there can upset the
+ * RX window timing. Logged when a callback takes longer than EVENT_BOUND_US.
+ */
+const u_int32_t EVENT_BOUND_US = 5000;
+static u_int32_t maxEventUs = 0;
+
+/*
+ * Command uplink queue and structure, sized for the largest command: a status update with
+ * every optional member (cmd, my-time, state, air, lq, ovr, boot), plus two spare members.
+ * Keys and string values are literals, which ArduinoJson keeps by pointer.
+ */
+const size_t CMD_JSON_SIZE = JSON_OBJECT_SIZE(7 + 2) + 2 * JSON_ARRAY_SIZE(2) + 2 * JSON_ARRAY_SIZE(3) + JSON_ARRAY_SIZE(BOOT_PHASES);
+
+// Arrays of a status update, replaced each time it is built
+static const char *const STATUS_ARRAYS[] = {"state", "air", "lq", "ovr"};
+static StaticJsonDocument<CMD_JSON_SIZE> cmdJson;
+
+/*
+ * Members that may be left out of a command when it does not fit the data rate,
+ * lowest priority first. Anything else is always sent, splitting it if needed.
+ */
+static const char *const OPTIONAL_FIELDS[] = {"lq", "air", "my-time"};
+static MsgType cmdType = MSG_STATUS;
+static Fragmenter fragmenter;
+static MsgType fragType = MSG_STATUS;
+
+/*
+ * How each kind of uplink is sent, indexed by MsgType. The startup request and power
+ * transitions are confirmed, LMIC retransmits them until acked. The startup request is
+ * queued again by statusUpdate() until it is answered, the heartbeat is resent every
+ * period anyway.
  */
-static StaticJsonDocument<MAX_LEN_PAYLOAD> cmdJson;
-static StaticJsonDocument<512> payloadJson;
+static const MsgPolicy MSG_POLICY[MSG_TYPES] = {
+    {PRIORITY_CRITICAL, true}, // MSG_START
+    {PRIORITY_LOW, false},     // MSG_STATUS
+    {PRIORITY_NORMAL, true},   // MSG_HISTORY
+    {PRIORITY_NORMAL, false},  // MSG_RESPONSE
+};
+static UplinkQueue uplinkQueue(MSG_POLICY);
 static boolean startUpComplete = false;
 
+/*
+ * Time to reach each boot phase, sent once in the first status update
+ */
+static BootTimer bootTimer;
+static boolean bootReported = false;
+
 /*
  * Array of Power schedules
  */
-static Schedule powerSched[25];
+const u_int8_t MAX_SCHEDULES = 25;
+static Schedule powerSched[MAX_SCHEDULES];
+static Schedule stagedSched[MAX_SCHEDULES]; // Filled from a downlink before it replaces powerSched
 static u_int8_t schedCount = 0;
 static boolean powerState[] = {false, false}; // Default both power switches to OFF
+static boolean schedState[] = {false, false}; // What the schedules want, before any override
+static boolean schedRestored = false;          // Schedules taken back from before a reset or power cut
+static osjob_t reconcileJob;
+
+/*
+ * Runtime state mirrored in no-init RAM by warmJob, so after a watchdog or software
+ * reset the node carries on with its schedules, relays and session instead of starting
+ * up and joining again
+ */
+struct WarmState
+{
+    Schedule sched[MAX_SCHEDULES];
+    u_int8_t schedCount;
+    boolean schedRestored;
+    boolean schedState[2]; // Overrides are not kept, the relays go back to the schedules
+    boolean startUpComplete;
+    boolean timeSet;
+    u_int32_t epoch;
+    LoraSession session; // devAddr 0 when not joined
+    FrameSession group;
+    boolean groupActive;
+};
+static_assert(sizeof(WarmState) <= WarmStore::CAPACITY, "WarmState does not fit the no-init record");
+
+// Changes with every build, so a warm restart into new firmware starts cold
+static const char BUILD_ID[] = __DATE__ " " __TIME__;
+static WarmStore warmStore(crc16((const uint8_t *)BUILD_ID, sizeof(BUILD_ID) - 1));
+static osjob_t warmJob;
+const u_int32_t WARM_SETTLE_MS = 5 * 60000UL; // Up this long, the mirrored state did not crash us
+void stateChanged();
+boolean loadSchedules();
+boolean loadRelays(boolean *relays);
+
+/*
+ * Relay driver outputs for the two power switches, HIGH is on. Pins 2 and 3 unless the
+ * board is wired otherwise, set with -D RELAY_PIN_1=n -D RELAY_PIN_2=n in build_flags.
+ */
+#ifndef RELAY_PIN_1
+#define RELAY_PIN_1 2
+#endif
+#ifndef RELAY_PIN_2
+#define RELAY_PIN_2 3
+#endif
+const u_int8_t RELAY_PINS[] = {RELAY_PIN_1, RELAY_PIN_2};
+
+/*
+ * Manual overrides from OP_OVERRIDE, and the job that ends them on time
+ */
+static RelayOverride overrides;
+static osjob_t overrideJob;
+
+/*
+ * The application's jobs that wait for a time, with their deadlines in uptime. Standby
+ * takes them off the LMIC queue for a sleep and puts them back after it, see idleCheck.
+ */
+struct TimedJob
+{
+    osjob_t *job;
+    osjobcb_t func;
+    u_int32_t dueMs;
+    boolean armed;
+};
+static TimedJob timedJobs[] = {{&statusJob, NULL, 0, false}, {&overrideJob, NULL, 0, false}, {&linkJob, NULL, 0, false}};
+
+TimedJob *findTimedJob(osjob_t *job)
+{
+    for (u_int8_t i = 0; i < sizeof(timedJobs) / sizeof(timedJobs[0]); ++i)
+    {
+        if (timedJobs[i].job == job)
+        {
+            return &timedJobs[i];
+        }
+    }
+    return NULL;
+}
+
+void runTimedJob(osjob_t *j)
+{
+    TimedJob *t = findTimedJob(j);
+    t->armed = false;
+    t->func(j);
+}
+
+/*
+ * Run func on job after ms, in place of os_setTimedCallback for the jobs above
+ */
+void setTimedJob(osjob_t *job, u_int32_t ms, osjobcb_t func)
+{
+    TimedJob *t = findTimedJob(job);
+    t->func = func;
+    t->dueMs = uptimeMs() + ms;
+    t->armed = true;
+    os_setTimedCallback(job, os_getTime() + ms2osticks(ms), runTimedJob);
+}
+
+void clearTimedJob(osjob_t *job)
+{
+    findTimedJob(job)->armed = false;
+    os_clearCallback(job);
+}
+
+/*
+ * History of power relay transitions, sent in batches on the heartbeat or when full
+ */
+static TransitionLog transLog;
+
+/*
+ * Schedules the server has sent before, kept in flash so it can switch between them by hash
+ */
+static ScheduleCache schedCache;
 
 /*
  * Command uplink queue and structure
@@ -72,9 +357,70 @@ const lmic_pinmap lmic_pins = {
  *  2. Include the power relay status and the current schedule for turning power on / off
  *
  * Schedule TX every this many seconds (might become longer due to duty cycle limitations).
+ * Default, see RuntimeConfig.
  */
 const unsigned TX_INTERVAL = 30;
 
+/*
+ * Status / power state heartbeat period. Each node sends in its own slot within the period,
+ * derived from the DevEUI, and every periodic run is dithered by up to TX_DITHER_MS so a
+ * fleet restarting after a site power cut does not collide at the gateway.
+ */
+const unsigned STATUS_PERIOD = 300;
+const unsigned TX_DITHER_MS = 2000;
+static u_int16_t txSlot = 0;
+static u_int32_t lastStatusPeriod = 0xFFFFFFFF;
+
+/*
+ * TTN uses the second US915 sub-band, 1 in a zero based count, see setup()
+ */
+const u_int8_t SUB_BAND = 1;
+
+// Schedules are in UTC unless configured otherwise
+const int16_t TZ_MINUTES = 0;
+
+// Let the network manage the data rate
+const boolean ADR_ENABLED = true;
+
+/*
+ * Network fair use airtime budget, TTN allows 30 seconds of uplink airtime per day.
+ * Low priority traffic is dropped and normal traffic deferred once it is reached,
+ * see AirtimeLedger. Default, see RuntimeConfig.
+ */
+const u_int16_t AIRTIME_HOUR_BUDGET_SEC = 10;
+const u_int16_t AIRTIME_DAY_BUDGET_SEC = 30;
+
+/*
+ * Runtime configuration, the defaults above until one is loaded from flash or patched
+ * with OP_CONFIG_SET
+ */
+static RuntimeConfig config = {TX_INTERVAL, STATUS_PERIOD, LOGGING_ENABLED, SUB_BAND, TZ_MINUTES,
+                               ADR_ENABLED, AIRTIME_HOUR_BUDGET_SEC, AIRTIME_DAY_BUDGET_SEC};
+static ConfigStore configStore(journal);
+
+/*
+ * LoRaWAN application ports used for the uplinks
+ *  1. MessagePack encoded commands (start, status)
+ *  2. Packed power transition history, see TransitionLog
+ *  3. Fragment of a command that was too large for the data rate, see Fragmenter
+ *  4. Response to a binary downlink command, see CommandTable
+ * and the downlinks
+ *  1. MessagePack encoded commands (init)
+ *  10. Binary opcode commands, see CommandTable
+ */
+const u1_t FPORT_CMD = 1;
+const u1_t FPORT_HISTORY = 2;
+const u1_t FPORT_FRAGMENT = 3;
+const u1_t FPORT_RESPONSE = 4;
+const u1_t FPORT_CONTROL = 10;
+
+// LMIC reports RSSI with this bias added
+const int LMIC_RSSI_OFFSET = 64;
+
+// Uplink airtime against the budget in config
+static AirtimeLedger airtime(AIRTIME_HOUR_BUDGET_SEC * 1000UL, AIRTIME_DAY_BUDGET_SEC * 1000UL);
+static u_int16_t airtimeDropped = 0;
+
 /*
  * Are we currenty waiting for a transmission to complete, if so a new tx will not be initiated
  */
@@ -85,6 +431,7 @@ static boolean txInProg = false;
  * If not then our local time is not yet valid and no scheduling should occur
  */
 static boolean timeSet = false;
+void timeSynced();
 
 /*
  * Request network time, hub should send the GPS time.
@@ -98,7 +445,7 @@ void network_time_cb(void *pUserData, int flagSuccess)
         logMsg(F("Network Time Recived, Update RTC, time: "));
         logMsg(netTime.tNetwork);
         rtc.setEpoch(netTime.tNetwork);
-        timeSet = true;
+        timeSynced();
     }
 }
 
@@ -110,18 +457,19 @@ void requestTime()
 }
 
 /*
- * If logging is turned on get the serial port setup and wait for it to be ready
+ * If logging is turned on get the serial port setup and give a serial monitor a moment
+ * to attach. Without a USB host the node carries on, output is then dropped.
  */
+const u_int32_t SERIAL_ATTACH_MS = 1000;
+
 void initSerial()
 {
-    if (LOGGING_ENABLED == true)
+    if (config.logging == true)
     {
         SerialUSB.begin(115200);
 
-        // Serial communication on startup is not consistent on the SAMD21. The
-        // following line waits for the serial monitor to be opened before
-        // continuing. Uncomment if not needed.
-        while (!SerialUSB)
+        u_int32_t start = millis();
+        while (!SerialUSB && millis() - start < SERIAL_ATTACH_MS)
             ;
 
         SerialUSB.println("Starting");
@@ -171,9 +519,78 @@ int dayOfWeek(time_t now, int tz_offset)
     return day_of_week;
 }
 
+/*
+ * Switch a relay and record the transition
+ */
+void setPower(u_int8_t ch, boolean state)
+{
+    powerState[ch] = state;
+    digitalWrite(RELAY_PINS[ch], state ? HIGH : LOW);
+    transLog.record(rtc.getEpoch(), ch, state);
+    stateChanged();
+
+    logMsg(F("\n*** Turn Power "));
+    logMsg(ch + 1);
+    logMsg(state ? F(" ON ***\n\n") : F(" OFF ***\n\n"));
+}
+
+void applyPower();
+
+void overrideExpired(osjob_t *j)
+{
+    applyPower();
+}
+
+/*
+ * Set the relays from the schedules, or from an override while one is running
+ */
+void applyPower()
+{
+    u_int32_t now = uptimeMs();
+    if (overrides.expire(now))
+    {
+        logMsg(F("Override expired\n"));
+    }
+
+    for (u_int8_t ch = 0; ch < RelayOverride::CHANNELS; ++ch)
+    {
+        boolean state = overrides.active(ch) ? overrides.state(ch) : schedState[ch];
+        if (powerState[ch] != state)
+        {
+            setPower(ch, state);
+        }
+    }
+
+    // Wake up for the next expiry, at least hourly so the tick count cannot overflow
+    u_int32_t wait = overrides.msToExpiry(now);
+    if (wait == 0xFFFFFFFF)
+    {
+        clearTimedJob(&overrideJob);
+        return;
+    }
+    if (wait > 3600000UL)
+    {
+        wait = 3600000UL;
+    }
+    setTimedJob(&overrideJob, wait, overrideExpired);
+}
+
+/*
+ * Schedules run once the server has sent them, or once the time is known again for
+ * schedules restored at boot
+ */
+boolean schedulesLive()
+{
+    return startUpComplete || (schedRestored && timeSet);
+}
+
 void checkSchedules()
 {
-    int curDOW = dayOfWeek(rtc.getEpoch(), 0);
+    // Schedules are set in local time
+    time_t local = rtc.getEpoch() + (time_t)config.tzMinutes * 60;
+    int curDOW = dayOfWeek(local, 0);
+    int curHour = (local / 3600) % 24;
+    int curMin = (local / 60) % 60;
 
     logMsg(F("Check Power Schedule, Current DOW: "));
     logMsg(curDOW);
@@ -195,12 +612,12 @@ void checkSchedules()
 
         logMsg(powerSched[i].hour);
         logMsg(F(" == "));
-        logMsg(rtc.getHours());
+        logMsg(curHour);
         logMsg(F("\n"));
 
         logMsg(powerSched[i].min);
         logMsg(F(" >= "));
-        logMsg(rtc.getMinutes());
+        logMsg(curMin);
         logMsg(F("\n"));
 
         logMsg(powerSched[i].powerState);
@@ -209,134 +626,1264 @@ void checkSchedules()
         logMsg(F("\n"));
         */
 
-        if (curDOW == powerSched[i].dow && rtc.getHours() == powerSched[i].hour && rtc.getMinutes() >= powerSched[i].min)
+        if (curDOW == powerSched[i].dow && curHour == powerSched[i].hour && curMin >= powerSched[i].min)
         {
             newState = powerSched[i].powerState;
         }
     }
 
-    if (powerState[0] != newState)
+    if (schedState[0] != newState)
+    {
+        schedState[0] = newState;
+        stateChanged();
+    }
+    applyPower();
+    bootTimer.mark(BOOT_SCHEDULE, uptimeMs());
+}
+
+/*
+ * The relays were restored to their last state at boot, bring them in line with the
+ * schedules now the time is known
+ */
+void reconcileSchedules(osjob_t *j)
+{
+    if (schedulesLive())
+    {
+        checkSchedules();
+    }
+}
+
+void timeSynced()
+{
+    timeSet = true;
+    bootTimer.mark(BOOT_TIME_SYNC, uptimeMs());
+    os_setCallback(&reconcileJob, reconcileSchedules);
+}
+
+/*
+ * After a power cut take the relay state and schedules back from the journal, so the
+ * outputs are as the schedules last had them until the schedules can be run again. An
+ * override ends with the power cut.
+ */
+void restoreState()
+{
+    if (loadSchedules())
+    {
+        schedRestored = true;
+    }
+    boolean relays[2];
+    if (loadRelays(relays))
+    {
+        for (u_int8_t ch = 0; ch < 2; ++ch)
+        {
+            schedState[ch] = relays[ch];
+            powerState[ch] = schedState[ch];
+        }
+    }
+}
+
+/*
+ * MessagePack command from the HangarServer on FPORT_CMD, decoded in a single pass
+ * over the downlink. The schedule list is decoded into the staging table and only
+ * replaces the active schedules once the whole command has been read.
+ */
+void handleCommand(const DownlinkView &dl)
+{
+    MsgPackReader rd(dl.data, dl.len);
+
+    const char *cmd = "";
+    u_int32_t cmdLen = 0;
+    u_int32_t curTime = 0;
+    u_int8_t stagedCount = 0;
+    boolean haveSched = false;
+    u_int32_t seq = 0;
+    boolean haveSeq = false;
+
+    if (dl.replay)
+    {
+        logMsg(F("Repeated downlink, FCnt: "));
+        logMsg(dl.fcnt);
+        logMsg(F(", ignored\n"));
+        return;
+    }
+
+    u_int32_t members = 0;
+    rd.readMap(members);
+    for (u_int32_t m = 0; m < members && rd.ok(); ++m)
     {
-        powerState[0] = newState;
-        if (newState == true)
+        const char *key;
+        u_int32_t keyLen;
+        if (!rd.readStr(key, keyLen))
+        {
+            break;
+        }
+
+        if (msgPackStrEquals(key, keyLen, "cmd"))
+        {
+            rd.readStr(cmd, cmdLen);
+        }
+        else if (msgPackStrEquals(key, keyLen, "cur-time"))
+        {
+            rd.readUint(curTime);
+        }
+        else if (msgPackStrEquals(key, keyLen, "seq"))
         {
-            logMsg(F("\n*** Turn Power ON ***\n\n"));
+            haveSeq = rd.readUint(seq);
+        }
+        else if (msgPackStrEquals(key, keyLen, "cmd-data"))
+        {
+            haveSched = decodeScheduleList(rd, stagedSched, MAX_SCHEDULES, stagedCount);
+            if (!haveSched)
+            {
+                break;
+            }
         }
         else
         {
-            logMsg(F("\n*** Turn Power OFF ***\n\n"));
+            rd.skip();
         }
     }
-}
 
-void processDownlink(lmic_t LMIC)
-{
-    if (LMIC.dataLen)
+    if (!rd.ok())
+    {
+        logMsg(F("Command decode failed\n"));
+        return;
+    }
+
+    logMsg(F("Command: "));
+    if (config.logging)
     {
-        logMsg(F("Received "));
-        logMsg(LMIC.dataLen);
-        logMsg(F(" bytes of payload\n"));
+        SerialUSB.write((const uint8_t *)cmd, cmdLen);
+    }
+    logMsg(F(", Time: "));
+    logMsg(curTime);
+    logMsg(F("\n"));
 
-        // Data is in: LMIC.frame + LMIC.dataBeg, LMIC.dataLen
-        payloadJson.clear();
-        DeserializationError err = deserializeMsgPack(payloadJson, LMIC.frame + LMIC.dataBeg, LMIC.dataLen);
-        if (err)
+    if (msgPackStrEquals(cmd, cmdLen, "init", true))
+    {
+        if (!haveSched)
         {
-            logMsg(F("deserializeJson() failed with code: "));
-            logMsg(err.c_str());
+            logMsg(F("Init without a valid schedule, ignored\n"));
+            return;
+        }
+        if (haveSeq && initSeqSeen && (int32_t)(seq - lastInitSeq) <= 0)
+        {
+            logMsg(F("Init already applied, seq: "));
+            logMsg(seq);
             logMsg(F("\n"));
+            return;
         }
-        else
+        if (haveSeq)
+        {
+            lastInitSeq = seq;
+            initSeqSeen = true;
+        }
+
+        rtc.setEpoch(curTime);
+        timeSynced();
+
+        memcpy(powerSched, stagedSched, stagedCount * sizeof(Schedule));
+        schedCount = stagedCount;
+        for (int i = 0; i < schedCount; ++i)
         {
-            const String cmd = payloadJson["cmd"];
-            const u_int32_t curTime = payloadJson["cur-time"];
+            logMsg(F("Sched ["));
+            logMsg(i);
+            logMsg(F("]: State: "));
+            logMsg(powerSched[i].powerState);
+            logMsg(F(", DOW: "));
+            logMsg(powerSched[i].dow);
 
-            logMsg(F("Command: "));
-            logMsg(cmd);
             logMsg(F(", Time: "));
-            logMsg(curTime);
+            print2digits(powerSched[i].hour);
+            logMsg(F(":"));
+            print2digits(powerSched[i].min);
             logMsg(F("\n"));
-
-            if (cmd.equalsIgnoreCase("init") == true)
-            {
-                rtc.setEpoch(curTime);
-
-                const JsonArray schedAry = payloadJson["cmd-data"];
-                schedCount = schedAry.size();
-                for (int i = 0; i < schedCount; ++i)
-                {
-                    const String sched = schedAry.getElement(i);
-                    DynamicJsonDocument oneSched(JSON_OBJECT_SIZE(3) + 20);
-                    deserializeJson(oneSched, sched);
-
-                    powerSched[i].powerState = oneSched["st"].as<bool>();
-                    powerSched[i].dow = oneSched["dow"].as<int>();
-
-                    const char *time = oneSched["tm"].as<char *>();
-                    char hour[3];
-                    strncpy(hour, time, 2);
-                    char min[3];
-                    strncpy(min, time + 2, 2);
-
-                    powerSched[i].hour = atoi(hour);
-                    powerSched[i].min = atoi(min);
-
-                    logMsg(F("Sched ["));
-                    logMsg(i);
-                    logMsg(F("]: State: "));
-                    logMsg(powerSched[i].powerState);
-                    logMsg(F(", DOW: "));
-                    logMsg(powerSched[i].dow);
-
-                    logMsg(F(", Time: "));
-                    print2digits(powerSched[i].hour);
-                    logMsg(F(":"));
-                    print2digits(powerSched[i].min);
-                    logMsg(F("\n"));
-                }
-
-                startUpComplete = true;
-                checkSchedules();
-            }
         }
+
+        startUpComplete = true;
+        checkSchedules();
     }
 }
 
-// We have completed joining the network
-// 1. set the LMIC / TTN options required
-// 2. Request the network time (This does not seem to be working yet on the TTN)
-// 3. Send the Startup command to the HangarServer
-void joinComplete()
+/*
+ * Binary commands on FPORT_CONTROL, [opcode][sequence][arguments], see CommandTable
+ */
+const u1_t OP_TIME_SET = 0x01;    // [epoch u4 LE]
+const u1_t OP_SCHED_ADD = 0x02;   // [dow | state << 7][hour][min], one or more entries
+const u1_t OP_SCHED_DEL = 0x03;   // [index], 0xFF clears all schedules
+const u1_t OP_SCHED_TMPL = 0x04;  // [template id][start hour][start min][duration min], see ScheduleTemplate
+const u1_t OP_SCHED_STORE = 0x05; // [dow | state << 7][hour][min]..., cache and apply a whole schedule
+const u1_t OP_SCHED_USE = 0x06;   // [hash u4 LE], apply a cached schedule, see ScheduleCache
+const u1_t OP_OVERRIDE = 0x08;    // [channel][state][minutes u2 LE], 0 minutes ends the override
+const u1_t OP_GROUP_SET = 0x10;   // [addr u4 LE][nwk key 16][app key 16][next fcnt u4 LE]
+const u1_t OP_GROUP_CLEAR = 0x11; // Leave the multicast group
+const u1_t OP_CONFIG_GET = 0x20;  // Reply with the runtime configuration, see RuntimeConfig
+const u1_t OP_CONFIG_SET = 0x21;  // [field][value]..., patch, store and apply the configuration
+const u1_t OP_DIAG = 0x7F;        // Reply with diagnostics
+
+CommandStatus cmdTimeSet(const uint8_t *args, uint8_t len, CommandReply &reply)
 {
-    logMsg(F("EV_JOINED\n"));
+    rtc.setEpoch(os_rlsbf4(args));
+    timeSynced();
+    return CMD_OK;
+}
 
-    // Disable link check validation (automatically enabled
-    // during join, but not supported by TTN at this time).
-    LMIC_setLinkCheckMode(0);
-    requestTime();
+CommandStatus cmdSchedAdd(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    if (len % 3 != 0)
+    {
+        return CMD_BAD_LENGTH;
+    }
+    if (schedCount + len / 3 > MAX_SCHEDULES)
+    {
+        return CMD_FAILED;
+    }
+
+    u_int8_t count;
+    if (!unpackSchedules(args, len, stagedSched, MAX_SCHEDULES, count))
+    {
+        return CMD_BAD_VALUE;
+    }
+    memcpy(powerSched + schedCount, stagedSched, count * sizeof(Schedule));
+    schedCount += count;
+
+    if (schedulesLive())
+    {
+        checkSchedules();
+    }
+    return CMD_OK;
 }
 
-void onEvent(ev_t ev)
+CommandStatus cmdSchedDel(const uint8_t *args, uint8_t len, CommandReply &reply)
 {
-    //logMsg(os_getTime());
-    printRTCTime();
-    logMsg(": ");
-    switch (ev)
+    if (args[0] == 0xFF)
     {
-    case EV_SCAN_TIMEOUT:
-        logMsg(F("EV_SCAN_TIMEOUT\n"));
-        break;
-    case EV_BEACON_FOUND:
-        logMsg(F("EV_BEACON_FOUND\n"));
-        break;
-    case EV_BEACON_MISSED:
-        logMsg(F("EV_BEACON_MISSED\n"));
-        break;
-    case EV_BEACON_TRACKED:
+        schedCount = 0;
+    }
+    else if (args[0] < schedCount)
+    {
+        memmove(&powerSched[args[0]], &powerSched[args[0] + 1], (schedCount - args[0] - 1) * sizeof(Schedule));
+        --schedCount;
+    }
+    else
+    {
+        return CMD_BAD_VALUE;
+    }
+
+    if (schedulesLive())
+    {
+        checkSchedules();
+    }
+    return CMD_OK;
+}
+
+/*
+ * Replace the schedules with a program from the template library. Reply: [entries]
+ */
+CommandStatus cmdSchedTemplate(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    u_int8_t count;
+    switch (expandTemplate(args, len, stagedSched, MAX_SCHEDULES, count))
+    {
+    case TEMPLATE_OK:
+        break;
+    case TEMPLATE_TOO_LARGE:
+        return CMD_FAILED;
+    default:
+        return CMD_BAD_VALUE;
+    }
+
+    memcpy(powerSched, stagedSched, count * sizeof(Schedule));
+    schedCount = count;
+    reply.data[0] = count;
+    reply.len = 1;
+
+    if (schedulesLive())
+    {
+        checkSchedules();
+    }
+    return CMD_OK;
+}
+
+/*
+ * Replace the schedules with a full table and cache it. Reply: [hash u4]
+ */
+CommandStatus cmdSchedStore(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    u_int8_t count;
+    if (!unpackSchedules(args, len, stagedSched, MAX_SCHEDULES, count))
+    {
+        return len % 3 != 0 ? CMD_BAD_LENGTH : CMD_BAD_VALUE;
+    }
+
+    memcpy(powerSched, stagedSched, count * sizeof(Schedule));
+    schedCount = count;
+    os_wlsbf4(reply.data, schedCache.store(args, len));
+    reply.len = 4;
+
+    if (schedulesLive())
+    {
+        checkSchedules();
+    }
+    return CMD_OK;
+}
+
+/*
+ * Replace the schedules with one from the cache, CMD_MISS asks the server for OP_SCHED_STORE
+ */
+CommandStatus cmdSchedUse(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    u_int8_t packed[ScheduleCache::MAX_LEN];
+    u_int8_t packedLen;
+    u_int8_t count;
+    if (!schedCache.load(os_rlsbf4(args), packed, packedLen))
+    {
+        return CMD_MISS;
+    }
+    if (!unpackSchedules(packed, packedLen, stagedSched, MAX_SCHEDULES, count))
+    {
+        return CMD_FAILED;
+    }
+
+    memcpy(powerSched, stagedSched, count * sizeof(Schedule));
+    schedCount = count;
+
+    if (schedulesLive())
+    {
+        checkSchedules();
+    }
+    return CMD_OK;
+}
+
+CommandStatus cmdConfigGet(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    encodeConfig(config, reply.data);
+    reply.len = RuntimeConfig::ENCODED_LEN;
+    return CMD_OK;
+}
+
+void updateTxSlot();
+void scheduleStatusUpdate();
+
+/*
+ * Reply: the configuration now in use, as OP_CONFIG_GET
+ */
+CommandStatus cmdConfigSet(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    RuntimeConfig old = config;
+    if (!patchConfig(config, args, len))
+    {
+        return CMD_BAD_VALUE;
+    }
+    configStore.save(config);
+
+    // Apply what can change without a restart
+    if (config.logging && !old.logging)
+    {
+        SerialUSB.begin(115200);
+    }
+#if defined(CFG_us915)
+    if (config.subBand != old.subBand)
+    {
+        LMIC_selectSubBand(config.subBand);
+    }
+#endif
+    if (config.adr != old.adr)
+    {
+        LMIC_setAdrMode(config.adr);
+    }
+    airtime.setBudget(config.airHourSec * 1000UL, config.airDaySec * 1000UL);
+    if (config.statusPeriod != old.statusPeriod)
+    {
+        updateTxSlot();
+        lastStatusPeriod = 0xFFFFFFFF;
+    }
+    if (config.txInterval != old.txInterval)
+    {
+        scheduleStatusUpdate();
+    }
+
+    return cmdConfigGet(args, len, reply);
+}
+
+/*
+ * Force a relay on or off for a while, takes effect at once
+ */
+CommandStatus cmdOverride(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    u_int8_t ch = args[0];
+    u_int16_t minutes = os_rlsbf2(args + 2);
+    if (ch >= RelayOverride::CHANNELS || args[1] > 1)
+    {
+        return CMD_BAD_VALUE;
+    }
+
+    if (minutes == 0)
+    {
+        overrides.clear(ch);
+    }
+    else
+    {
+        overrides.set(ch, args[1] == 1, (u_int32_t)minutes * 60000, uptimeMs());
+    }
+    applyPower();
+    return CMD_OK;
+}
+
+void startListening(osjob_t *j);
+
+CommandStatus cmdGroupSet(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    groupSession.devAddr = os_rlsbf4(args);
+    memcpy(groupSession.nwkKey, args + 4, 16);
+    memcpy(groupSession.appKey, args + 20, 16);
+    groupSession.nextFCnt = os_rlsbf4(args + 36);
+    groupActive = true;
+
+    // Starts listening once this response has gone out
+    return CMD_OK;
+}
+
+void stopListening();
+
+CommandStatus cmdGroupClear(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    stopListening();
+    groupActive = false;
+    return CMD_OK;
+}
+
+/*
+ * Reply: [uptime s u4][schedule count][uplinks queued][flags][airtime today ms u4]
+ *        [longest event callback us u2]
+ *   flags: 0x01 startup complete, 0x02 time set, 0x04 power 1 on, 0x08 power 2 on,
+ *          0x10 power 1 overridden, 0x20 power 2 overridden, 0xC0 LinkState
+ */
+CommandStatus cmdDiag(const uint8_t *args, uint8_t len, CommandReply &reply)
+{
+    os_wlsbf4(reply.data, uptimeMs() / 1000);
+    reply.data[4] = schedCount;
+    reply.data[5] = uplinkQueue.size();
+    reply.data[6] = (startUpComplete ? 0x01 : 0) | (timeSet ? 0x02 : 0) | (powerState[0] ? 0x04 : 0) | (powerState[1] ? 0x08 : 0) |
+                    (overrides.active(0) ? 0x10 : 0) | (overrides.active(1) ? 0x20 : 0) | (linkMonitor.state() << 6);
+    os_wlsbf4(reply.data + 7, airtime.dayMs(rtc.getEpoch()));
+    os_wlsbf2(reply.data + 11, maxEventUs > 0xFFFF ? 0xFFFF : maxEventUs);
+    reply.len = 13;
+    return CMD_OK;
+}
+
+/*
+ * Command registry, by port and opcode with the allowed argument length, and whether
+ * the command may be sent to the multicast group
+ */
+static constexpr CommandDef COMMANDS[] = {
+    {FPORT_CONTROL, OP_TIME_SET, 4, 4, CMD_GROUP, cmdTimeSet},
+    {FPORT_CONTROL, OP_SCHED_ADD, 3, 3 * MAX_SCHEDULES, CMD_GROUP, cmdSchedAdd},
+    {FPORT_CONTROL, OP_SCHED_DEL, 1, 1, CMD_GROUP, cmdSchedDel},
+    {FPORT_CONTROL, OP_SCHED_TMPL, 1, 4, CMD_GROUP, cmdSchedTemplate},
+    {FPORT_CONTROL, OP_SCHED_STORE, 0, 3 * MAX_SCHEDULES, CMD_GROUP, cmdSchedStore},
+    {FPORT_CONTROL, OP_SCHED_USE, 4, 4, CMD_GROUP, cmdSchedUse},
+    {FPORT_CONTROL, OP_OVERRIDE, 4, 4, 0, cmdOverride},
+    {FPORT_CONTROL, OP_GROUP_SET, 40, 40, 0, cmdGroupSet},
+    {FPORT_CONTROL, OP_GROUP_CLEAR, 0, 0, 0, cmdGroupClear},
+    {FPORT_CONTROL, OP_CONFIG_GET, 0, 0, 0, cmdConfigGet},
+    {FPORT_CONTROL, OP_CONFIG_SET, 2, 21, 0, cmdConfigSet},
+    {FPORT_CONTROL, OP_DIAG, 0, 0, 0, cmdDiag},
+};
+const u_int8_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+static CommandSeq commandSeqs[COMMAND_COUNT];
+static CommandSeq groupSeqs[COMMAND_COUNT];
+
+/*
+ * Sequence numbers kept in the journal, so a command or init replayed after a reboot
+ * or a rejoin is still recognised as a repeat
+ */
+struct SeqState
+{
+    u_int32_t lastInitSeq;
+    boolean initSeqSeen;
+    CommandSeq commands[COMMAND_COUNT];
+    CommandSeq group[COMMAND_COUNT];
+};
+static_assert(sizeof(SeqState) <= Journal::MAX_LEN, "SeqState does not fit a journal record");
+static_assert(sizeof(FrameSession) <= Journal::MAX_LEN, "FrameSession does not fit a journal record");
+
+/*
+ * Answer a command with [opcode][sequence][status][reply data] on FPORT_RESPONSE
+ */
+void queueResponse(u_int8_t opcode, u_int8_t seq, CommandStatus status, const CommandReply &reply)
+{
+    UplinkFrame *frame = uplinkQueue.add(MSG_RESPONSE, FPORT_RESPONSE);
+    if (frame == NULL)
+    {
+        logMsg(F("Uplink queue full, command response dropped\n"));
+        return;
+    }
+
+    frame->data[0] = opcode;
+    frame->data[1] = seq;
+    frame->data[2] = status;
+    memcpy(frame->data + 3, reply.data, reply.len);
+    frame->len = 3 + reply.len;
+}
+
+void handleControl(const DownlinkView &dl)
+{
+    u_int8_t opcode;
+    u_int8_t seq;
+    CommandReply reply;
+    CommandStatus status;
+
+    if (dl.replay && dl.len >= 2)
+    {
+        // The network repeated the frame, answer again without running it
+        opcode = dl.data[0];
+        seq = dl.data[1];
+        reply.len = 0;
+        status = CMD_DUPLICATE;
+    }
+    else
+    {
+        CommandSeq *seqs = dl.multicast ? groupSeqs : commandSeqs;
+        status = runCommand(COMMANDS, seqs, COMMAND_COUNT, dl, opcode, seq, reply);
+    }
+
+    logMsg(dl.multicast ? F("Group opcode: ") : F("Opcode: "));
+    logMsg(opcode);
+    logMsg(F(", Status: "));
+    logMsg(status);
+    logMsg(F("\n"));
+
+    if (!dl.multicast)
+    {
+        queueResponse(opcode, seq, status, reply);
+    }
+}
+
+/*
+ * Downlink handlers by application port
+ */
+static const DownlinkRoute DOWNLINK_ROUTES[] = {
+    {FPORT_CMD, handleCommand},
+    {FPORT_CONTROL, handleControl},
+};
+
+// Only binary commands are taken from the multicast group
+static const DownlinkRoute GROUP_ROUTES[] = {
+    {FPORT_CONTROL, handleControl},
+};
+
+void processDownlink(const DownlinkView &dl)
+{
+    logMsg(F("Received "));
+    logMsg(dl.len);
+    logMsg(F(" bytes of payload on port "));
+    logMsg(dl.port);
+    logMsg(F(", RSSI: "));
+    logMsg(dl.rssi);
+    logMsg(F("\n"));
+
+    boolean handled = dl.multicast ? dispatchDownlink(dl, GROUP_ROUTES, sizeof(GROUP_ROUTES) / sizeof(GROUP_ROUTES[0]))
+                                   : dispatchDownlink(dl, DOWNLINK_ROUTES, sizeof(DOWNLINK_ROUTES) / sizeof(DOWNLINK_ROUTES[0]));
+    if (!handled)
+    {
+        logMsg(F("No handler for port\n"));
+    }
+}
+
+/*
+ * Run the handlers for the downlinks received since the last run, outside the LMIC callback
+ */
+void processInbound(osjob_t *j)
+{
+    const InboundFrame *frame;
+    while ((frame = inbound.front()) != NULL)
+    {
+        processDownlink(frame->view());
+        inbound.pop();
+    }
+    stateChanged();
+}
+
+/*
+ * Called from the LMIC event callback: copy any application data LMIC received into the
+ * inbound queue and leave the processing to downlinkJob, so the callback stays short.
+ */
+void receiveDownlink()
+{
+    if (LMIC.dataLen == 0 || (LMIC.txrxFlags & TXRX_PORT) == 0)
+    {
+        return;
+    }
+
+    linkMonitor.heard();
+
+    DownlinkView dl;
+    dl.data = LMIC.frame + LMIC.dataBeg;
+    dl.len = LMIC.dataLen;
+    dl.port = LMIC.frame[LMIC.dataBeg - 1];
+    dl.flags = LMIC.txrxFlags;
+    dl.rssi = LMIC.rssi - LMIC_RSSI_OFFSET;
+    dl.snr = LMIC.snr;
+
+    // LMIC has already moved seqnoDn on to the next expected FCntDown
+    dl.fcnt = LMIC.seqnoDn - 1;
+    dl.replay = fcntSeen && dl.fcnt == lastFCntDown;
+    dl.multicast = false;
+    lastFCntDown = dl.fcnt;
+    fcntSeen = true;
+
+    if (!inbound.push(dl))
+    {
+        logMsg(F("Inbound queue full, downlink dropped\n"));
+        return;
+    }
+    os_setCallback(&downlinkJob, processInbound);
+}
+
+/*
+ * LMIC has nothing scheduled that needs the radio: no join, uplink or receive window pending
+ */
+boolean lmicIdle()
+{
+    return (LMIC.opmode & (OP_SCAN | OP_TRACK | OP_JOINING | OP_TXDATA | OP_POLL | OP_REJOIN | OP_TXRXPEND)) == 0;
+}
+
+void listenPoll(osjob_t *j);
+
+/*
+ * Borrow the idle radio for continuous receive on the RX2 channel, in Class C or while
+ * in a multicast group. The radio is driven by RadioRx and polled from rxPollJob, LMIC's
+ * own jobs are left alone.
+ */
+void startListening(osjob_t *j)
+{
+    if (!(CLASS_C || groupActive) || listening || !lmicIdle() || LMIC.devaddr == 0)
+    {
+        return;
+    }
+
+    radioRxStart(LMIC.dn2Freq, dndr2rps(LMIC.dn2Dr));
+    os_setTimedCallback(&rxPollJob, os_getTime() + ms2osticks(RX_POLL_MS), listenPoll);
+    listening = true;
+}
+
+/*
+ * Hand the radio back to LMIC, before any uplink
+ */
+void stopListening()
+{
+    if (!listening)
+    {
+        return;
+    }
+
+    os_clearCallback(&rxPollJob);
+    radioRxStop();
+    listening = false;
+}
+
+#if CLASS_C
+const u_int8_t MHDR_CONFIRMED_DOWN = 0xA0;
+
+/*
+ * Frame for this node received between uplinks, checked against the LMIC session.
+ * MAC commands in FOpts are not processed, the network repeats them in a later RX1 / RX2.
+ */
+boolean decodeUnicast(u_int8_t *frame, u_int8_t len, DownlinkView &dl)
+{
+    FrameSession unicast;
+    unicast.devAddr = LMIC.devaddr;
+    memcpy(unicast.nwkKey, LMIC.nwkKey, sizeof(unicast.nwkKey));
+    memcpy(unicast.appKey, LMIC.artKey, sizeof(unicast.appKey));
+    unicast.nextFCnt = LMIC.seqnoDn;
+
+    boolean confirmed = frame[0] == MHDR_CONFIRMED_DOWN;
+    if (!decodeDownFrame(unicast, frame, len, dl))
+    {
+        return false;
+    }
+
+    LMIC.seqnoDn = unicast.nextFCnt;
+    if (confirmed)
+    {
+        // Acked on the next uplink, as LMIC does for the RX1 / RX2 windows
+        LMIC.dnConf = FCTRL_ACK;
+    }
+    lastFCntDown = dl.fcnt;
+    fcntSeen = true;
+    dl.flags = TXRX_PORT;
+    dl.multicast = false;
+    return true;
+}
+#endif
+
+void listenPoll(osjob_t *j)
+{
+    if (!lmicIdle())
+    {
+        // LMIC has work for the radio and programs it from scratch, leave it alone
+        listening = false;
+        return;
+    }
+
+    int16_t rssi;
+    int8_t snr;
+    u_int8_t len = radioRxPoll(rxFrame, sizeof(rxFrame), rssi, snr);
+
+    DownlinkView dl;
+    boolean received = false;
+    if (len > 0 && groupActive && decodeDownFrame(groupSession, rxFrame, len, dl))
+    {
+        dl.multicast = true;
+        received = true;
+    }
+#if CLASS_C
+    else if (len > 0 && decodeUnicast(rxFrame, len, dl))
+    {
+        received = true;
+    }
+#endif
+
+    if (received)
+    {
+        dl.rssi = rssi;
+        dl.snr = snr;
+        quality.sample(dl.rssi, dl.snr);
+        if (inbound.push(dl))
+        {
+            os_setCallback(&downlinkJob, processInbound);
+        }
+        else
+        {
+            logMsg(F("Inbound queue full, downlink dropped\n"));
+        }
+    }
+
+    // Anything else on the channel (other nodes' downlinks, bad MIC) is ignored, the
+    // radio stays in continuous receive
+    os_setTimedCallback(&rxPollJob, os_getTime() + ms2osticks(RX_POLL_MS), listenPoll);
+}
+
+/*
+ * Airtime of the frame the radio is about to send, called on EV_TXSTART so joins
+ * and LMIC retransmissions are counted as well.
+ */
+uint32_t txAirtimeUs()
+{
+    rps_t rps = LMIC.rps;
+    return timeOnAirUs(getSf(rps) - SF7 + 7, 125 << getBw(rps), getCr(rps) + 1, LMIC.dataLen, getNocrc(rps) == 0, getIh(rps) != 0);
+}
+
+#if CLASS_B
+void startTracking(osjob_t *j)
+{
+    logMsg(F("Beacon scan\n"));
+    LMIC_enableTracking(0);
+}
+
+void retryTracking()
+{
+    os_setTimedCallback(&beaconJob, os_getTime() + sec2osticks(BEACON_RETRY_SEC), startTracking);
+}
+
+// Beacon time is GPS time, which has no leap seconds
+const u_int32_t GPS_UNIX_OFFSET = 315964800;
+const u_int32_t GPS_LEAP_SECONDS = 18;
+
+/*
+ * Set the RTC from the beacon just received, when it is off by more than a second
+ */
+void beaconTime()
+{
+    if ((LMIC.bcninfo.flags & (BCN_PARTIAL | BCN_FULL)) == 0)
+    {
+        return;
+    }
+
+    // The beacon time is for the start of its transmission
+    u_int32_t epoch = LMIC.bcninfo.time + GPS_UNIX_OFFSET - GPS_LEAP_SECONDS + osticks2ms(os_getTime() - LMIC.bcninfo.txtime) / 1000;
+    int32_t diff = epoch - rtc.getEpoch();
+    if (timeSet && diff >= -1 && diff <= 1)
+    {
+        return;
+    }
+
+    rtc.setEpoch(epoch);
+    timeSynced();
+    logMsg(F("Beacon time, update RTC: "));
+    logMsg(epoch);
+    logMsg(F("\n"));
+}
+#endif
+
+#if defined(CFG_us915)
+const u_int8_t US915_CHANNELS = 72;
+const u_int8_t CHANNEL_MAP_BITS = 8 * sizeof(LMIC.channelMap[0]);
+#endif
+
+/*
+ * Copy the LMIC session state, devAddr is 0 when not joined
+ */
+void captureSession(LoraSession &s)
+{
+    LMIC_getSessionKeys(&s.netId, &s.devAddr, s.nwkKey, s.appKey);
+    s.seqnoUp = LMIC.seqnoUp;
+    s.seqnoDn = LMIC.seqnoDn;
+    s.datarate = LMIC.datarate;
+    s.rxDelay = LMIC.rxDelay;
+    s.rx1DrOffset = LMIC.rx1DrOffset;
+    s.dn2Dr = LMIC.dn2Dr;
+    s.dn2Freq = LMIC.dn2Freq;
+
+    memset(s.channels, 0, sizeof(s.channels));
+#if defined(CFG_us915)
+    for (u_int8_t ch = 0; ch < US915_CHANNELS; ++ch)
+    {
+        if (LMIC.channelMap[ch / CHANNEL_MAP_BITS] & (1 << (ch % CHANNEL_MAP_BITS)))
+        {
+            s.channels[ch / 8] |= 1 << (ch % 8);
+        }
+    }
+#endif
+}
+
+/*
+ * Hand a saved session to LMIC, skipping fcntSkip up counters that may have been used
+ */
+void applySession(const LoraSession &s, u_int32_t fcntSkip)
+{
+    LMIC_setSession(s.netId, s.devAddr, (xref2u1_t)s.nwkKey, (xref2u1_t)s.appKey);
+#if defined(CFG_us915)
+    for (u_int8_t ch = 0; ch < US915_CHANNELS; ++ch)
+    {
+        if (s.channels[ch / 8] & (1 << (ch % 8)))
+        {
+            LMIC_enableChannel(ch);
+        }
+        else
+        {
+            LMIC_disableChannel(ch);
+        }
+    }
+#endif
+    LMIC_setDrTxpow(s.datarate, KEEP_TXPOW);
+
+    // LMIC_setSession leaves the receive windows at the regional defaults, the network
+    // may have moved them in the join accept (TTN uses a 5 s RX1 delay)
+    LMIC.rxDelay = s.rxDelay;
+    LMIC.rx1DrOffset = s.rx1DrOffset;
+    LMIC.dn2Dr = s.dn2Dr;
+    LMIC.dn2Freq = s.dn2Freq;
+
+    LMIC.seqnoUp = s.seqnoUp + fcntSkip;
+    LMIC.seqnoDn = s.seqnoDn;
+    LMIC_setLinkCheckMode(0);
+}
+
+/*
+ * Copy the LMIC session into flash, run as a job as the flash erase is too slow for
+ * the event callback
+ */
+void saveSession(osjob_t *j)
+{
+    captureSession(session);
+    sessionStore.save(session);
+    logMsg(F("Session saved, FCntUp: "));
+    logMsg(session.seqnoUp);
+    logMsg(F("\n"));
+}
+
+/*
+ * Save the frame counters of the saved session, run as a job like saveSession
+ */
+void saveCounters(osjob_t *j)
+{
+    session.seqnoUp = LMIC.seqnoUp;
+    session.seqnoDn = LMIC.seqnoDn;
+    sessionStore.saveCounters(session);
+}
+
+/*
+ * Carry on with the session saved before the reboot instead of joining
+ */
+boolean restoreSession()
+{
+    if (!sessionStore.load(session))
+    {
+        return false;
+    }
+
+    // Counters are only saved every FCNT_SAVE_STEP uplinks, skip any that may have been used
+    applySession(session, SessionStore::FCNT_SAVE_STEP);
+
+    sessionRestored = true;
+    saveCounters(&sessionJob);
+    requestTime();
+#if CLASS_B
+    os_setCallback(&beaconJob, startTracking);
+#endif
+    return true;
+}
+
+/*
+ * Mirror the runtime state into no-init RAM
+ */
+void saveWarm(osjob_t *j)
+{
+    WarmState warm;
+    memset(&warm, 0, sizeof(warm));
+    memcpy(warm.sched, powerSched, sizeof(warm.sched));
+    warm.schedCount = schedCount;
+    warm.schedRestored = schedRestored;
+    warm.schedState[0] = schedState[0];
+    warm.schedState[1] = schedState[1];
+    warm.startUpComplete = startUpComplete;
+    warm.timeSet = timeSet;
+    warm.epoch = rtc.getEpoch();
+    captureSession(warm.session);
+    warm.group = groupSession;
+    warm.groupActive = groupActive;
+    warmStore.save(&warm, sizeof(warm));
+    if (uptimeMs() > WARM_SETTLE_MS)
+    {
+        warmStore.settled();
+    }
+}
+
+/*
+ * Write the relay state the schedules want, the schedules, the command sequence numbers
+ * and the group session to the journal, if they changed. Overrides are left out, they do
+ * not outlast a reset.
+ */
+void persistState(osjob_t *j)
+{
+    u_int8_t relays[] = {schedState[0], schedState[1]};
+    journal.update(JOURNAL_RELAY, relays, sizeof(relays));
+
+    u_int8_t packed[3 * MAX_SCHEDULES];
+    journal.update(JOURNAL_SCHEDULE, packed, packSchedules(powerSched, schedCount, packed));
+
+    SeqState seqs;
+    memset(&seqs, 0, sizeof(seqs));
+    seqs.lastInitSeq = lastInitSeq;
+    seqs.initSeqSeen = initSeqSeen;
+    memcpy(seqs.commands, commandSeqs, sizeof(seqs.commands));
+    memcpy(seqs.group, groupSeqs, sizeof(seqs.group));
+    journal.update(JOURNAL_SEQS, &seqs, sizeof(seqs));
+
+    // The group frame counter moves with every group downlink, which are few
+    journal.update(JOURNAL_GROUP, &groupSession, groupActive ? sizeof(groupSession) : 0);
+}
+
+/*
+ * Read back the schedules persistState wrote, into the active table. False if there are
+ * none or they do not unpack.
+ */
+boolean loadSchedules()
+{
+    u_int8_t buf[Journal::MAX_LEN];
+    u_int8_t len;
+    return journal.load(JOURNAL_SCHEDULE, buf, sizeof(buf), len) && unpackSchedules(buf, len, powerSched, MAX_SCHEDULES, schedCount);
+}
+
+/*
+ * Read back the relay state persistState wrote, false if there is none
+ */
+boolean loadRelays(boolean *relays)
+{
+    u_int8_t buf[Journal::MAX_LEN];
+    u_int8_t len;
+    if (!journal.load(JOURNAL_RELAY, buf, sizeof(buf), len) || len != 2)
+    {
+        return false;
+    }
+    relays[0] = buf[0] != 0;
+    relays[1] = buf[1] != 0;
+    return true;
+}
+
+/*
+ * Take the command sequence numbers back from the journal, after any kind of reset
+ */
+void restoreSeqs()
+{
+    SeqState seqs;
+    u_int8_t len;
+    if (!journal.load(JOURNAL_SEQS, &seqs, sizeof(seqs), len) || len != sizeof(seqs))
+    {
+        return;
+    }
+    lastInitSeq = seqs.lastInitSeq;
+    initSeqSeen = seqs.initSeqSeen;
+    memcpy(commandSeqs, seqs.commands, sizeof(commandSeqs));
+    memcpy(groupSeqs, seqs.group, sizeof(groupSeqs));
+}
+
+/*
+ * Take the multicast group session back from the journal, so the node stays in the group
+ * and still refuses group frames it has already seen
+ */
+void restoreGroup()
+{
+    u_int8_t len;
+    groupActive = journal.load(JOURNAL_GROUP, &groupSession, sizeof(groupSession), len) && len == sizeof(groupSession);
+}
+
+/*
+ * Keep the no-init RAM and flash copies of the runtime state current
+ */
+void stateChanged()
+{
+    os_setCallback(&warmJob, saveWarm);
+    os_setCallback(&persistJob, persistState);
+}
+
+/*
+ * The no-init RAM only holds state after a reset with the power kept on
+ */
+boolean coldBoot()
+{
+    return (PM->RCAUSE.reg & (PM_RCAUSE_POR | PM_RCAUSE_BOD12 | PM_RCAUSE_BOD33)) != 0;
+}
+
+/*
+ * Take back the schedules, relay state and time mirrored before a warm reset. An override
+ * ends with the reset, the relays go back to what the schedules want.
+ */
+boolean resumeWarm(WarmState &warm)
+{
+    if (coldBoot() || !warmStore.load(&warm, sizeof(warm)))
+    {
+        warmStore.clear();
+        return false;
+    }
+
+    memcpy(powerSched, warm.sched, sizeof(powerSched));
+    schedCount = warm.schedCount;
+    startUpComplete = warm.startUpComplete;
+    timeSet = warm.timeSet;
+    schedRestored = warm.schedRestored;
+    for (u_int8_t ch = 0; ch < 2; ++ch)
+    {
+        powerState[ch] = schedState[ch] = warm.schedState[ch];
+    }
+    groupSession = warm.group;
+    groupActive = warm.groupActive;
+
+    // The RTC counts on through a reset, unless it was set up again from scratch
+    if (rtc.getEpoch() < warm.epoch)
+    {
+        rtc.setEpoch(warm.epoch);
+    }
+    if (timeSet)
+    {
+        bootTimer.mark(BOOT_TIME_SYNC, uptimeMs());
+    }
+    if (startUpComplete)
+    {
+        bootTimer.mark(BOOT_SCHEDULE, uptimeMs());
+    }
+    return true;
+}
+
+/*
+ * Carry on with the live session from before a warm reset, no rejoin or flash restore
+ */
+void resumeWarmSession(const LoraSession &s)
+{
+    sessionStore.load(session);
+    // The last uplink may have gone out after the state was mirrored
+    applySession(s, 1);
+    if (!timeSet)
+    {
+        requestTime();
+    }
+#if CLASS_B
+    os_setCallback(&beaconJob, startTracking);
+#endif
+}
+
+/*
+ * Restart LMIC from scratch, settling any uplink it was still sending
+ */
+void resetLmic()
+{
+    stopListening();
+    LMIC_reset();
+#if defined(CFG_us915)
+    LMIC_selectSubBand(config.subBand);
+#endif
+    LMIC_setAdrMode(config.adr);
+
+    if (txInProg)
+    {
+        MsgType type;
+        uplinkQueue.txComplete(false, type);
+        txInProg = false;
+    }
+}
+
+/*
+ * The network does not know the restored session, forget it and join
+ */
+void dropSession(osjob_t *j)
+{
+    logMsg(F("Restored session not answered, joining\n"));
+    sessionStore.clear();
+    sessionRestored = false;
+    resetLmic();
+    LMIC_startJoining();
+}
+
+void rejoin(osjob_t *j)
+{
+    if (LMIC.opmode & OP_JOINING)
+    {
+        return;
+    }
+
+    logMsg(F("Offline, rejoining\n"));
+    sessionRestored = false;
+    resetLmic();
+    LMIC_startJoining();
+}
+
+/*
+ * Wait before trying the next join, rather than letting LMIC retry on its own schedule
+ */
+void scheduleRejoin()
+{
+    u_int32_t wait = linkMonitor.nextRejoinSec();
+    logMsg(F("Next rejoin in s: "));
+    logMsg(wait);
+    logMsg(F("\n"));
+    setTimedJob(&linkJob, wait * 1000, rejoin);
+}
+
+void joinFailed(osjob_t *j)
+{
+    linkMonitor.joinFailed();
+    resetLmic();
+    scheduleRejoin();
+}
+
+/*
+ * Confirmed uplink not acked: give up on the session once the link is offline. The data
+ * rate is left to ADR, or to the link quality estimate when ADR is off.
+ */
+void linkMissed()
+{
+    LinkState before = linkMonitor.state();
+    linkMonitor.missed();
+
+    if (linkMonitor.state() == LINK_OFFLINE && before != LINK_OFFLINE)
+    {
+        logMsg(F("Link offline\n"));
+        scheduleRejoin();
+    }
+}
+
+/*
+ * Feed the link quality estimate from any frame LMIC received in an RX window or ping slot
+ */
+void sampleLink()
+{
+    if (LMIC.txrxFlags & (TXRX_DNW1 | TXRX_DNW2 | TXRX_PING))
+    {
+        quality.sample(LMIC.rssi - LMIC_RSSI_OFFSET, LMIC.snr);
+    }
+}
+
+/*
+ * Settle the queued frame that was just sent, confirmed frames are removed on the ack
+ * or queued again for a retry after a NACK.
+ */
+void uplinkComplete()
+{
+    MsgType type;
+    TxOutcome outcome = uplinkQueue.txComplete((LMIC.txrxFlags & TXRX_ACK) != 0, type);
+    switch (outcome)
+    {
+    case TX_ACKED:
+        // The network knows this session
+        sessionRestored = false;
+        linkMonitor.heard();
+        quality.ackResult(true);
+        logMsg(F("Uplink acked, type: "));
+        break;
+    case TX_FAILED:
+        if (type == MSG_START && sessionRestored)
+        {
+            os_setCallback(&sessionJob, dropSession);
+        }
+        quality.ackResult(false);
+        linkMissed();
+        logMsg(F("Uplink not acked, type: "));
+        break;
+    default:
+        return;
+    }
+    logMsg(type);
+    logMsg(F("\n"));
+}
+
+// We have completed joining the network
+// 1. set the LMIC / TTN options required
+// 2. Request the network time (This does not seem to be working yet on the TTN)
+// 3. Send the Startup command to the HangarServer
+void joinComplete()
+{
+    logMsg(F("EV_JOINED\n"));
+    bootTimer.mark(BOOT_JOINED, uptimeMs());
+
+    // A new session restarts the downlink frame counter
+    fcntSeen = false;
+    linkMonitor.heard();
+    os_setCallback(&sessionJob, saveSession);
+    stateChanged();
+#if CLASS_B
+    os_setCallback(&beaconJob, startTracking);
+#endif
+
+    // Disable link check validation (automatically enabled
+    // during join, but not supported by TTN at this time).
+    LMIC_setLinkCheckMode(0);
+    requestTime();
+}
+
+void handleEvent(ev_t ev)
+{
+    //logMsg(os_getTime());
+    printRTCTime();
+    logMsg(": ");
+    switch (ev)
+    {
+    case EV_SCAN_TIMEOUT:
+        logMsg(F("EV_SCAN_TIMEOUT\n"));
+#if CLASS_B
+        retryTracking();
+#endif
+        break;
+    case EV_BEACON_FOUND:
+        logMsg(F("EV_BEACON_FOUND\n"));
+#if CLASS_B
+        beaconTime();
+        LMIC_setPingable(CLASS_B_PING_EXP);
+#endif
+        break;
+    case EV_BEACON_MISSED:
+        logMsg(F("EV_BEACON_MISSED\n"));
+        break;
+    case EV_BEACON_TRACKED:
         logMsg(F("EV_BEACON_TRACKED\n"));
+#if CLASS_B
+        beaconTime();
+#endif
         break;
     case EV_JOINING:
         logMsg(F("EV_JOINING\n"));
+        bootTimer.mark(BOOT_JOIN_START, uptimeMs());
         break;
     case EV_JOINED:
         joinComplete();
@@ -346,9 +1893,11 @@ void onEvent(ev_t ev)
         break;
     case EV_JOIN_FAILED:
         logMsg(F("EV_JOIN_FAILED\n"));
+        os_setCallback(&linkJob, joinFailed);
         break;
     case EV_REJOIN_FAILED:
         logMsg(F("EV_REJOIN_FAILED\n"));
+        os_setCallback(&linkJob, joinFailed);
         break;
 
     case EV_TXCOMPLETE:
@@ -360,13 +1909,33 @@ void onEvent(ev_t ev)
 
         // Mark the transmission complete
         txInProg = false;
+        sampleLink();
+        uplinkComplete();
+
+        // Keep the saved frame counter within FCNT_SAVE_STEP of the one in use, and save
+        // the whole session again if the network moved the receive windows
+        if (LMIC.rxDelay != session.rxDelay || LMIC.rx1DrOffset != session.rx1DrOffset || LMIC.dn2Dr != session.dn2Dr ||
+            LMIC.dn2Freq != session.dn2Freq)
+        {
+            os_setCallback(&sessionJob, saveSession);
+        }
+        else if (LMIC.seqnoUp - session.seqnoUp >= SessionStore::FCNT_SAVE_STEP)
+        {
+            os_setCallback(&sessionJob, saveCounters);
+        }
+        stateChanged();
 
         // If any data recieved, process it
-        processDownlink(LMIC);
+        receiveDownlink();
 
+        // Listen on RX2 again once LMIC has settled
+        os_setCallback(&listenJob, startListening);
         break;
     case EV_LOST_TSYNC:
         logMsg(F("EV_LOST_TSYNC\n"));
+#if CLASS_B
+        retryTracking();
+#endif
         break;
     case EV_RESET:
         logMsg(F("EV_RESET\n"));
@@ -374,21 +1943,44 @@ void onEvent(ev_t ev)
     case EV_RXCOMPLETE:
         // data received in ping slot
         logMsg(F("EV_RXCOMPLETE\n"));
+        sampleLink();
 
         // If any data recieved, process it
-        processDownlink(LMIC);
+        receiveDownlink();
         break;
     case EV_LINK_DEAD:
         logMsg(F("EV_LINK_DEAD\n"));
+        linkMonitor.linkDead();
+        if (linkMonitor.state() == LINK_OFFLINE)
+        {
+            scheduleRejoin();
+        }
         break;
     case EV_LINK_ALIVE:
         logMsg(F("EV_LINK_ALIVE\n"));
+        linkMonitor.heard();
         break;
     case EV_TXSTART:
         logMsg(F("EV_TXSTART\n"));
+        airtime.add(rtc.getEpoch(), txAirtimeUs());
+        break;
+    case EV_TXCANCELED:
+        // LMIC dropped the pending uplink before sending it, it goes out again
+        logMsg(F("EV_TXCANCELED\n"));
+        if (txInProg)
+        {
+            uplinkQueue.cancel();
+            txInProg = false;
+        }
         break;
     case EV_JOIN_TXCOMPLETE:
+        // Join request sent, no accept received. LMIC tries again by itself, only back
+        // off once several attempts in a row went unanswered.
         logMsg(F("EV_JOIN_TXCOMPLETE \n"));
+        if (linkMonitor.joinUnanswered())
+        {
+            os_setCallback(&linkJob, joinFailed);
+        }
         break;
     default:
         logMsg(F("Unknown event: "));
@@ -398,6 +1990,208 @@ void onEvent(ev_t ev)
     }
 }
 
+void onEvent(ev_t ev)
+{
+    u_int32_t start = micros();
+    handleEvent(ev);
+    u_int32_t took = micros() - start;
+
+    if (took > maxEventUs)
+    {
+        maxEventUs = took;
+    }
+    if (took > EVENT_BOUND_US)
+    {
+        logMsg(F("Slow event callback, us: "));
+        logMsg(took);
+        logMsg(F("\n"));
+    }
+}
+
+/*
+ * Number of bytes we can send in the next uplink at the current data rate
+ */
+size_t uplinkBudget()
+{
+    size_t budget = maxAppPayload(LMIC.datarate);
+    return budget > MAX_LEN_PAYLOAD ? MAX_LEN_PAYLOAD : budget;
+}
+
+/*
+ * Check the airtime budget before handing a frame of msgLen bytes to the radio
+ */
+BudgetDecision checkAirtime(MsgPriority prio, size_t msgLen)
+{
+    BudgetDecision decision = airtime.check(rtc.getEpoch(), prio, uplinkTimeOnAirUs(LMIC.datarate, msgLen));
+    if (decision == BUDGET_DEFER)
+    {
+        logMsg(F("Airtime budget reached, deferring\n"));
+    }
+    else if (decision == BUDGET_DROP)
+    {
+        logMsg(F("Airtime budget reached, dropping low priority message\n"));
+        ++airtimeDropped;
+    }
+    return decision;
+}
+
+/*
+ * Queue the next fragment of a message that was too large for the data rate
+ */
+UplinkFrame *queueFragment(size_t budget)
+{
+    if (!fragmenter.fit(budget))
+    {
+        logMsg(F("Fragment does not fit data rate, waiting\n"));
+        return NULL;
+    }
+
+    logMsg(F("Fragment "));
+    logMsg(fragmenter.fragmentIndex() + 1);
+    logMsg(F(" of "));
+    logMsg(fragmenter.fragmentCount());
+    logMsg(F("\n"));
+
+    UplinkFrame *frame = uplinkQueue.add(fragType, FPORT_FRAGMENT);
+    frame->len = fragmenter.next(frame->data);
+    fragmenter.commit();
+    return frame;
+}
+
+/*
+ * Queue the pending command, dropping optional members or splitting it across
+ * several uplinks when it is larger than the data rate allows.
+ */
+UplinkFrame *queueCommand(size_t budget)
+{
+    int trimmed = trimToBudget(cmdJson, budget, OPTIONAL_FIELDS, sizeof(OPTIONAL_FIELDS) / sizeof(OPTIONAL_FIELDS[0]));
+    if (trimmed > 0)
+    {
+        logMsg(F("Removed optional fields: "));
+        logMsg(trimmed);
+        logMsg(F("\n"));
+    }
+
+    logMsg(F("MessagePack, size: "));
+    logMsg(measureMsgPack(cmdJson));
+    logMsg(F(", budget: "));
+    logMsg(budget);
+    logMsg(F("\n"));
+
+    u_int8_t msg[UplinkFrame::MAX_LEN];
+    size_t msgLen = serializeMsgPack(cmdJson, msg, sizeof(msg));
+    if (msgLen <= budget)
+    {
+        UplinkFrame *frame = uplinkQueue.add(cmdType, FPORT_CMD);
+        memcpy(frame->data, msg, msgLen);
+        frame->len = msgLen;
+        cmdJson.clear();
+        return frame;
+    }
+
+    // Too large even without the optional members, send it in pieces
+    if (fragmenter.load(msg, msgLen, budget))
+    {
+        fragType = cmdType;
+        cmdJson.clear();
+        return queueFragment(budget);
+    }
+
+    logMsg(F("Command too large for data rate, waiting\n"));
+    return NULL;
+}
+
+/*
+ * Move the next message into the uplink queue: fragments of a split message first,
+ * then the pending command and finally the batched power transitions.
+ */
+UplinkFrame *queueNext(size_t budget)
+{
+    if (uplinkQueue.full())
+    {
+        return NULL;
+    }
+
+    if (fragmenter.pending())
+    {
+        return queueFragment(budget);
+    }
+    if (cmdJson.size() > 0)
+    {
+        return queueCommand(budget);
+    }
+    if (transLog.flushPending())
+    {
+        UplinkFrame *frame = uplinkQueue.add(MSG_HISTORY, FPORT_HISTORY);
+        uint8_t entries = 0;
+        frame->len = transLog.encode(frame->data, budget, entries);
+        if (entries == 0)
+        {
+            uplinkQueue.remove(frame);
+            return NULL;
+        }
+        transLog.commit(entries);
+        return frame;
+    }
+    return NULL;
+}
+
+/*
+ * Hand a queued frame to LMIC, confirmed or not as its message policy says
+ */
+void transmit(UplinkFrame *frame, size_t budget)
+{
+    const MsgPolicy &policy = uplinkQueue.policy(*frame);
+    u_int32_t now = rtc.getEpoch();
+
+    if (frame->len > budget)
+    {
+        // Built before the data rate dropped, hold it until the link improves
+        logMsg(F("Frame too large for data rate, waiting\n"));
+        uplinkQueue.defer(frame, now + config.txInterval);
+        return;
+    }
+
+    BudgetDecision decision = checkAirtime(policy.priority, frame->len);
+    if (decision == BUDGET_DROP)
+    {
+        if (frame->port == FPORT_FRAGMENT)
+        {
+            fragmenter.clear();
+        }
+        uplinkQueue.remove(frame);
+    }
+    if (decision != BUDGET_SEND)
+    {
+        return;
+    }
+
+    stopListening();
+    lmic_tx_error_t sndErr = LMIC_setTxData2(frame->port, frame->data, frame->len, policy.confirmed ? 1 : 0);
+    if (sndErr != 0)
+    {
+        // LMIC refuses this frame, drop it rather than block the queue behind it
+        logMsg(F("Send error, dropped: "));
+        logMsg(sndErr);
+        logMsg(F("\n"));
+        if (frame->port == FPORT_FRAGMENT)
+        {
+            fragmenter.clear();
+        }
+        uplinkQueue.remove(frame);
+        txInProg = false;
+        return;
+    }
+
+    logMsg(F("Transmit, type: "));
+    logMsg(frame->type);
+    logMsg(F(", size: "));
+    logMsg(frame->len);
+    logMsg(policy.confirmed ? F(", confirmed\n") : F("\n"));
+    uplinkQueue.sent(frame);
+    txInProg = true;
+}
+
 void do_send()
 {
     // Check if there is not a current TX/RX job running
@@ -405,43 +2199,79 @@ void do_send()
     {
         logMsg(F("OP_TXRXPEND, not sending\n"));
     }
+    else if (!linkMonitor.canSend())
+    {
+        // Queued messages wait for the rejoin, the heartbeat is rebuilt each period anyway
+        logMsg(F("Offline, not sending\n"));
+    }
     else
     {
         /*
      * If we have any commands queued internally then prepare upstream data transmission at the next possible time.
      * And add the command to the LMIC send queue.
      */
+        if (!config.adr && quality.chooseDr() != LMIC.datarate)
+        {
+            // No ADR, pick the data rate from the link quality before sizing the payload
+            LMIC_setDrTxpow(quality.chooseDr(), KEEP_TXPOW);
+        }
+        size_t budget = uplinkBudget();
+
         printRTCTime();
         logMsg(F(" Command JSON, Entries: "));
         logMsg(cmdJson.size());
+        logMsg(F(", Queued: "));
+        logMsg(uplinkQueue.size());
+        logMsg(F(", DR: "));
+        logMsg(LMIC.datarate);
         logMsg(F("\n"));
 
-        if (cmdJson.size() > 0)
+        // Retries that are due go first, otherwise queue up the next message
+        UplinkFrame *frame = uplinkQueue.nextReady(rtc.getEpoch());
+        if (frame == NULL)
         {
-            logMsg(F("MessagePack, size: "));
-            logMsg(measureJson(cmdJson));
-            logMsg(F("\n"));
-
-            size_t msgLen = serializeMsgPack(cmdJson, &LMIC.pendTxData, MAX_LEN_PAYLOAD);
-            lmic_tx_error_t sndErr = LMIC_setTxData2(1, NULL, msgLen, 0);
-            if (sndErr != 0)
-            {
-                logMsg(F("Send Command error : "));
-                logMsg(sndErr);
-                logMsg(F("\n"));
-            }
-            else
-            {
-                logMsg(F("Transmit, size: "));
-                logMsg(msgLen);
-                logMsg(F("\n"));
-            }
-
-            cmdJson.clear();
+            frame = queueNext(budget);
+        }
+        if (frame != NULL)
+        {
+            transmit(frame, budget);
         }
     }
 }
 
+void statusUpdate(osjob_t *j);
+
+/*
+ * A startup request is already waiting to be sent, retried or acknowledged
+ */
+boolean startQueued()
+{
+    return uplinkQueue.holds(MSG_START) || (fragmenter.pending() && fragType == MSG_START);
+}
+
+/*
+ * This node's uplink slot within the status period, from the DevEUI
+ */
+void updateTxSlot()
+{
+    u1_t devEui[8];
+    os_getDevEui(devEui);
+    txSlot = uplinkSlot(devEui, sizeof(devEui), config.statusPeriod);
+    logMsg(F("Uplink slot: "));
+    logMsg(txSlot);
+    logMsg(F("\n"));
+}
+
+/*
+ * Arm the status job for the next work interval boundary of this node's slot, plus dither
+ */
+void scheduleStatusUpdate()
+{
+    u_int32_t wait = secondsToSlot(rtc.getEpoch(), txSlot, config.txInterval);
+    u_int32_t dither = (u_int32_t)os_getRndU1() * TX_DITHER_MS / 256;
+    setTimedJob(&statusJob, wait * 1000 + dither, statusUpdate);
+}
+
 /*
  * Main work method, will perform any scheduled tasks and send status updates
  *  1. Check the schedule and turn the power on or off if needed.
@@ -453,18 +2283,30 @@ void statusUpdate(osjob_t *j)
     /*
      * Send the initial startup commond just once
      */
-    if (startUpComplete == false)
+    if (startUpComplete == false && !startQueued())
     {
         logMsg(F("Queue Startup Req\n"));
         cmdJson["cmd"] = "start";
         cmdJson["my-time"] = rtc.getEpoch();
+        cmdType = MSG_START;
     }
 
     /*
-     * Send a status / power state update every 5 min.
+     * Send a status / power state update every 5 min, in this node's slot.
      */
-    if (startUpComplete && rtc.getMinutes() % 5 == 0)
+    u_int32_t period = slotPeriod(rtc.getEpoch(), txSlot, config.statusPeriod);
+    if (startUpComplete && period != lastStatusPeriod)
     {
+        lastStatusPeriod = period;
+
+        // A status still waiting to go out is rebuilt. ArduinoJson does not reuse the
+        // memory of removed or replaced members, so drop the old arrays and reclaim it.
+        for (u_int8_t i = 0; i < sizeof(STATUS_ARRAYS) / sizeof(STATUS_ARRAYS[0]); ++i)
+        {
+            cmdJson.remove(STATUS_ARRAYS[i]);
+        }
+        cmdJson.garbageCollect();
+
         DynamicJsonDocument startDoc(JSON_ARRAY_SIZE(3));
         JsonArray stateArray = startDoc.to<JsonArray>();
         stateArray.add(powerState[0]); // Power port 1 status
@@ -474,12 +2316,61 @@ void statusUpdate(osjob_t *j)
         cmdJson["cmd"] = "status";
         cmdJson["my-time"] = rtc.getEpoch();
         cmdJson["state"] = stateArray;
+        cmdType = MSG_STATUS;
+
+        // Airtime used in the last hour and day (ms), and messages dropped to stay in budget
+        uint32_t epoch = rtc.getEpoch();
+        JsonArray airArray = cmdJson.createNestedArray("air");
+        airArray.add(airtime.hourMs(epoch));
+        airArray.add(airtime.dayMs(epoch));
+        airArray.add(airtimeDropped);
+
+        // Link quality: average RSSI (dBm), SNR (dB * 4) and confirmed uplink loss (%)
+        if (quality.valid())
+        {
+            JsonArray lqArray = cmdJson.createNestedArray("lq");
+            lqArray.add(quality.rssi());
+            lqArray.add(quality.snr());
+            lqArray.add(quality.lossPercent());
+        }
+
+        // Seconds left on any manual override, per power port
+        if (overrides.active(0) || overrides.active(1))
+        {
+            JsonArray ovrArray = cmdJson.createNestedArray("ovr");
+            ovrArray.add(overrides.remainingSec(0, uptimeMs()));
+            ovrArray.add(overrides.remainingSec(1, uptimeMs()));
+        }
+
+        // ms from power on to each boot phase, see BootPhase
+        if (!bootReported)
+        {
+            JsonArray bootArray = cmdJson.createNestedArray("boot");
+            boolean added = !bootArray.isNull();
+            for (u_int8_t i = 0; i < BOOT_PHASES && added; ++i)
+            {
+                added = bootArray.add(bootTimer.ms((BootPhase)i));
+            }
+
+            // Try again with the next status rather than send part of it
+            if (added)
+            {
+                bootReported = true;
+            }
+            else
+            {
+                cmdJson.remove("boot");
+            }
+        }
+
+        // Heartbeat, send any power transitions since the last one
+        transLog.requestFlush();
     }
 
     /*
      * Check the current schedule for any power on / off changes
      */
-    if (startUpComplete)
+    if (schedulesLive())
     {
         checkSchedules();
     }
@@ -492,35 +2383,186 @@ void statusUpdate(osjob_t *j)
         do_send();
     }
 
+    /*
+     * Keep the radio on the multicast group between uplinks
+     */
+    startListening(j);
+
+    /*
+     * Keep the warm restart copy current
+     */
+    stateChanged();
+
     /*
      * Schedule the next status / work update run
      */
-    os_setTimedCallback(&statusJob, os_getTime() + sec2osticks(TX_INTERVAL), statusUpdate);
+    scheduleStatusUpdate();
+}
+
+/*
+ * Tickless idle. idleJob is a timed job that is always due, so it only runs when no other
+ * job is runnable. When the radio and LMIC are idle it sleeps in standby until shortly
+ * before the next of the application's timed jobs. Not while a terminal has the USB
+ * serial port open with logging on, standby drops the USB connection, nor in Class B / C
+ * where the radio is always in use.
+ *
+ * The SysTick stops in standby, so the LMIC clock does not count the time asleep: LMIC
+ * just sees no time pass. The node only sleeps when LMIC has no timed job of its own, and
+ * the application's timed jobs are put back on the queue from their uptime deadlines.
+ */
+const u_int32_t SLEEP_MIN_SEC = 2;      // Not worth stopping the clocks for less
+const u_int32_t SLEEP_MAX_SEC = 900;    // Longest single sleep
+const u_int32_t LMIC_HORIZON_SEC = 3600; // LMIC jobs further out than this do not hold off a sleep
+const u_int32_t IDLE_POLL_MS = 10;
+static osjob_t idleJob;
+
+boolean canSleep()
+{
+    return !CLASS_B && !CLASS_C && !(config.logging && SerialUSB) && !listening && !txInProg && lmicIdle() &&
+           inbound.front() == NULL;
+}
+
+/*
+ * Whole seconds until the next timed job is due, up to SLEEP_MAX_SEC
+ */
+u_int32_t secondsToNextJob()
+{
+    u_int32_t now = uptimeMs();
+    u_int32_t wait = SLEEP_MAX_SEC * 1000;
+    for (u_int8_t i = 0; i < sizeof(timedJobs) / sizeof(timedJobs[0]); ++i)
+    {
+        int32_t due = timedJobs[i].dueMs - now;
+        if (timedJobs[i].armed && (due < 0 || (u_int32_t)due < wait))
+        {
+            wait = due < 0 ? 0 : due;
+        }
+    }
+    return wait / 1000;
+}
+
+/*
+ * Sleep with the application's timed jobs off the queue, unless LMIC has one of its own
+ */
+void sleepFor(u_int32_t seconds)
+{
+    for (u_int8_t i = 0; i < sizeof(timedJobs) / sizeof(timedJobs[0]); ++i)
+    {
+        os_clearCallback(timedJobs[i].job);
+    }
+
+    if (!os_queryTimeCriticalJobs(sec2osticks(LMIC_HORIZON_SEC)))
+    {
+        // The watchdog clock runs in standby too
+        watchdogStop();
+        standbySleep(rtc, seconds);
+        watchdogStart();
+    }
+
+    u_int32_t now = uptimeMs();
+    for (u_int8_t i = 0; i < sizeof(timedJobs) / sizeof(timedJobs[0]); ++i)
+    {
+        if (timedJobs[i].armed)
+        {
+            int32_t due = timedJobs[i].dueMs - now;
+            os_setTimedCallback(timedJobs[i].job, os_getTime() + ms2osticks(due < 0 ? 0 : due), runTimedJob);
+        }
+    }
+}
+
+void idleCheck(osjob_t *j)
+{
+    if (canSleep())
+    {
+        // Wake a second early, the RTC only counts whole seconds
+        u_int32_t idle = secondsToNextJob();
+        if (idle > SLEEP_MIN_SEC)
+        {
+            sleepFor(idle - 1);
+        }
+    }
+    os_setTimedCallback(&idleJob, os_getTime() + ms2osticks(IDLE_POLL_MS), idleCheck);
 }
 
 void setup()
 {
-    initSerial();
+    bootTimer.mark(BOOT_CLOCK, uptimeMs());
     rtc.begin(); // Start up the Real Time Clock
+    bootTimer.mark(BOOT_RTC, uptimeMs());
+    watchdogStart();
+
+    // Relays back as they were before anything slow: after a watchdog or software reset
+    // pick up where we left off, after a power cut take the last state from flash
+    journal.begin();
+    restoreSeqs();
+    restoreGroup();
+    WarmState warm;
+    boolean warmStart = resumeWarm(warm);
+    if (!warmStart)
+    {
+        restoreState();
+    }
+    for (u_int8_t ch = 0; ch < sizeof(RELAY_PINS); ++ch)
+    {
+        digitalWrite(RELAY_PINS[ch], powerState[ch] ? HIGH : LOW);
+        pinMode(RELAY_PINS[ch], OUTPUT);
+    }
+
+    boolean configLoaded = configStore.load(config);
+    airtime.setBudget(config.airHourSec * 1000UL, config.airDaySec * 1000UL);
+    schedCache.begin();
+    bootTimer.mark(BOOT_FLASH, uptimeMs());
+
+    initSerial();
+    logMsg(configLoaded ? F("Config loaded from flash\n") : F("Default config\n"));
+    logMsg(warmStart ? F("Warm restart\n") : F("Cold start\n"));
+    logMsg(F("Relays restored: "));
+    logMsg(powerState[0]);
+    logMsg(F(", "));
+    logMsg(powerState[1]);
+    logMsg(F("\n"));
 
     // LMIC init
     // Reset the MAC state. Session and pending data transfers will be discarded.
     os_init();
     LMIC_reset();
+    bootTimer.mark(BOOT_OS_INIT, uptimeMs());
 
 #if defined(CFG_us915)
     // NA-US channels 0-71 are configured automatically
     // but only one group of 8 should (a subband) should be active
     // TTN recommends the second sub band, 1 in a zero based count.
     // https://github.com/TheThingsNetwork/gateway-conf/blob/master/US-global_conf.json
-    LMIC_selectSubBand(1);
+    LMIC_selectSubBand(config.subBand);
 #endif
+    LMIC_setAdrMode(config.adr);
+
+    // Skip the join when the session from before the reset is still in RAM, or in flash
+    if (warmStart && warm.session.devAddr != 0)
+    {
+        resumeWarmSession(warm.session);
+        bootTimer.mark(BOOT_JOINED, uptimeMs());
+        logMsg(F("Session resumed, DevAddr: "));
+        logMsg(warm.session.devAddr);
+        logMsg(F("\n"));
+    }
+    else if (restoreSession())
+    {
+        bootTimer.mark(BOOT_JOINED, uptimeMs());
+        logMsg(F("Session restored, DevAddr: "));
+        logMsg(session.devAddr);
+        logMsg(F("\n"));
+    }
+
+    // Find our transmit slot from the DevEUI
+    updateTxSlot();
 
-    // Start job (sending automatically starts OTAA too)
-    statusUpdate(&statusJob);
+    // Start job in our slot (sending automatically starts OTAA too)
+    scheduleStatusUpdate();
+    os_setCallback(&idleJob, idleCheck);
 }
 
 void loop()
 {
+    watchdogFeed();
     os_runloop_once();
 }
\ No newline at end of file
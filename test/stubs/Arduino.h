@@ -0,0 +1,10 @@
+#pragma once
+
+/*
+ * Host stand-in for the Arduino core, just what the modules under test use
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef bool boolean;
@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+ * Host stand-in for the FlashStorage library. The flash arrays the modules declare are
+ * const, so each FlashClass keeps its flash in a host copy instead, with NOR semantics:
+ * an erase sets bytes to 0xFF and a write can only clear bits.
+ *
+ * Tests simulate a power loss with writeBudget(), the number of bytes still written
+ * before the power goes, an erase costs one. Past it nothing more reaches the flash.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <vector>
+
+class FlashClass
+{
+public:
+    FlashClass(const void *flash_addr = NULL, uint32_t size = 0)
+        : base((const uint8_t *)flash_addr), image((const uint8_t *)flash_addr, (const uint8_t *)flash_addr + size)
+    {
+        regions().push_back(this);
+    }
+
+    void write(const volatile void *flash_ptr, const void *data, uint32_t size)
+    {
+        uint8_t *to = at(flash_ptr);
+        const uint8_t *from = (const uint8_t *)data;
+        for (uint32_t i = 0; i < size && spend(); ++i)
+        {
+            to[i] &= from[i];
+        }
+    }
+
+    void erase(const volatile void *flash_ptr, uint32_t size)
+    {
+        if (spend())
+        {
+            ++eraseCount();
+            memset(at(flash_ptr), 0xFF, size);
+        }
+    }
+
+    // Erase the whole array
+    void erase()
+    {
+        erase(base, image.size());
+    }
+
+    void read(const volatile void *flash_ptr, void *data, uint32_t size)
+    {
+        memcpy(data, at(flash_ptr), size);
+    }
+
+    // Bytes written before a simulated power loss, LONG_MAX for none
+    static long &writeBudget()
+    {
+        static long budget = LONG_MAX;
+        return budget;
+    }
+
+    // Erases since the start of the test run
+    static uint32_t &eraseCount()
+    {
+        static uint32_t count = 0;
+        return count;
+    }
+
+    // Put every flash array back as it was programmed, all zero
+    static void reset()
+    {
+        for (FlashClass *flash : regions())
+        {
+            memset(flash->image.data(), 0, flash->image.size());
+        }
+        writeBudget() = LONG_MAX;
+    }
+
+private:
+    static std::vector<FlashClass *> &regions()
+    {
+        static std::vector<FlashClass *> all;
+        return all;
+    }
+
+    uint8_t *at(const volatile void *flash_ptr)
+    {
+        return image.data() + ((const uint8_t *)flash_ptr - base);
+    }
+
+    static bool spend()
+    {
+        if (writeBudget() == 0)
+        {
+            return false;
+        }
+        if (writeBudget() != LONG_MAX)
+        {
+            --writeBudget();
+        }
+        return true;
+    }
+
+    const uint8_t *base;
+    std::vector<uint8_t> image;
+};
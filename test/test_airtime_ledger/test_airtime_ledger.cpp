@@ -0,0 +1,100 @@
+#include <unity.h>
+#include <AirtimeLedger.hpp>
+
+static const uint32_t T0 = 1599998400; // On an hour boundary
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_time_on_air_matches_the_datasheet_formula()
+{
+    // SF7 / 125 kHz, 13 bytes: 12.25 preamble and 33 payload symbols of 1.024 ms
+    TEST_ASSERT_EQUAL_UINT32(46336, timeOnAirUs(7, 125, 1, 13, true, false));
+    TEST_ASSERT_EQUAL_UINT32(46336, uplinkTimeOnAirUs(3, 0));
+
+    // SF12 / 125 kHz needs the low data rate optimisation: 8 + 3 * 5 payload symbols
+    TEST_ASSERT_EQUAL_UINT32(1155072, timeOnAirUs(12, 125, 1, 13, true, false));
+
+    // Slower data rates cost more for the same payload
+    TEST_ASSERT_GREATER_THAN(uplinkTimeOnAirUs(1, 20), uplinkTimeOnAirUs(0, 20));
+    TEST_ASSERT_LESS_THAN(uplinkTimeOnAirUs(3, 20), uplinkTimeOnAirUs(4, 20));
+}
+
+void test_airtime_adds_up_in_whole_milliseconds()
+{
+    AirtimeLedger ledger(30000, 300000);
+    ledger.add(T0, 46336);
+    ledger.add(T0 + 10, 1000);
+    TEST_ASSERT_EQUAL_UINT32(48, ledger.hourMs(T0 + 20));
+    TEST_ASSERT_EQUAL_UINT32(48, ledger.dayMs(T0 + 20));
+    TEST_ASSERT_EQUAL_UINT32(48, ledger.totalMs());
+}
+
+void test_old_airtime_ages_out_of_the_hour_and_the_day()
+{
+    AirtimeLedger ledger(30000, 300000);
+    ledger.add(T0, 100000);
+    ledger.add(T0 + 3600, 200000);
+
+    TEST_ASSERT_EQUAL_UINT32(200, ledger.hourMs(T0 + 3600 + 60));
+    TEST_ASSERT_EQUAL_UINT32(300, ledger.dayMs(T0 + 3600 + 60));
+    TEST_ASSERT_EQUAL_UINT32(0, ledger.hourMs(T0 + 7200));
+    TEST_ASSERT_EQUAL_UINT32(200, ledger.dayMs(T0 + 86400));
+    TEST_ASSERT_EQUAL_UINT32(0, ledger.dayMs(T0 + 2 * 86400));
+    TEST_ASSERT_EQUAL_UINT32(300, ledger.totalMs());
+}
+
+void test_clock_steps_keep_the_totals()
+{
+    AirtimeLedger ledger(30000, 300000);
+    ledger.add(1000, 500000);
+    TEST_ASSERT_EQUAL_UINT32(500, ledger.hourMs(T0));
+    ledger.add(T0 + 10, 500000);
+    TEST_ASSERT_EQUAL_UINT32(1000, ledger.hourMs(T0 - 100));
+}
+
+void test_budget_decision_depends_on_priority()
+{
+    AirtimeLedger ledger(1000, 10000);
+    ledger.add(T0, 700000);
+
+    // Low priority traffic only gets 75 % of the budget
+    TEST_ASSERT_EQUAL(BUDGET_SEND, ledger.check(T0, PRIORITY_LOW, 50000));
+    TEST_ASSERT_EQUAL(BUDGET_DROP, ledger.check(T0, PRIORITY_LOW, 51000));
+    TEST_ASSERT_EQUAL(BUDGET_SEND, ledger.check(T0, PRIORITY_NORMAL, 300000));
+    TEST_ASSERT_EQUAL(BUDGET_DEFER, ledger.check(T0, PRIORITY_NORMAL, 301000));
+    TEST_ASSERT_EQUAL(BUDGET_SEND, ledger.check(T0, PRIORITY_CRITICAL, 5000000));
+
+    // The day budget counts as well
+    AirtimeLedger daily(100000, 1000);
+    daily.add(T0, 900000);
+    TEST_ASSERT_EQUAL(BUDGET_DEFER, daily.check(T0 + 7200, PRIORITY_NORMAL, 200000));
+}
+
+void test_new_budget_applies_to_the_airtime_already_used()
+{
+    AirtimeLedger ledger(1000, 10000);
+    ledger.add(T0, 700000);
+    TEST_ASSERT_EQUAL(BUDGET_SEND, ledger.check(T0, PRIORITY_NORMAL, 300000));
+
+    ledger.setBudget(800, 10000);
+    TEST_ASSERT_EQUAL(BUDGET_DEFER, ledger.check(T0, PRIORITY_NORMAL, 300000));
+    TEST_ASSERT_EQUAL(BUDGET_SEND, ledger.check(T0, PRIORITY_NORMAL, 100000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_time_on_air_matches_the_datasheet_formula);
+    RUN_TEST(test_airtime_adds_up_in_whole_milliseconds);
+    RUN_TEST(test_old_airtime_ages_out_of_the_hour_and_the_day);
+    RUN_TEST(test_clock_steps_keep_the_totals);
+    RUN_TEST(test_budget_decision_depends_on_priority);
+    RUN_TEST(test_new_budget_applies_to_the_airtime_already_used);
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#include <unity.h>
+#include <Fragmenter.hpp>
+
+static uint8_t message[Fragmenter::MAX_MESSAGE];
+
+// Send every fragment of a message and put it back together, returns its length
+static size_t reassemble(Fragmenter &frag, uint8_t *out)
+{
+    size_t len = 0;
+    uint8_t frame[Fragmenter::HEADER_LEN + 0xFF];
+    while (frag.pending())
+    {
+        size_t frameLen = frag.next(frame);
+        TEST_ASSERT_EQUAL(frag.fragmentIndex(), frame[1] >> 4);
+        TEST_ASSERT_EQUAL(frag.fragmentCount() - 1, frame[1] & 0x0F);
+        memcpy(out + len, frame + Fragmenter::HEADER_LEN, frameLen - Fragmenter::HEADER_LEN);
+        len += frameLen - Fragmenter::HEADER_LEN;
+        frag.commit();
+    }
+    return len;
+}
+
+void setUp()
+{
+    for (size_t i = 0; i < sizeof(message); ++i)
+    {
+        message[i] = (uint8_t)(i * 7 + 3);
+    }
+}
+
+void tearDown()
+{
+}
+
+void test_message_splits_into_fragments_that_reassemble()
+{
+    Fragmenter frag;
+    TEST_ASSERT_TRUE(frag.load(message, 100, 11 + Fragmenter::HEADER_LEN));
+    TEST_ASSERT_EQUAL(10, frag.fragmentCount());
+
+    uint8_t out[Fragmenter::MAX_MESSAGE];
+    TEST_ASSERT_EQUAL(100, reassemble(frag, out));
+    TEST_ASSERT_EQUAL_MEMORY(message, out, 100);
+}
+
+void test_message_needing_too_many_fragments_is_refused()
+{
+    Fragmenter frag;
+    TEST_ASSERT_FALSE(frag.load(message, Fragmenter::MAX_MESSAGE, 10));
+    TEST_ASSERT_FALSE(frag.pending());
+    TEST_ASSERT_FALSE(frag.load(message, Fragmenter::MAX_MESSAGE + 1, 0xFF));
+    TEST_ASSERT_FALSE(frag.load(message, 10, Fragmenter::HEADER_LEN));
+}
+
+void test_fit_keeps_the_position_when_the_budget_allows()
+{
+    Fragmenter frag;
+    frag.load(message, 40, 12);
+    uint8_t frame[12];
+    frag.next(frame);
+    uint8_t seq = frame[0];
+    frag.commit();
+
+    TEST_ASSERT_TRUE(frag.fit(51));
+    TEST_ASSERT_EQUAL(1, frag.fragmentIndex());
+    frag.next(frame);
+    TEST_ASSERT_EQUAL(seq, frame[0]);
+}
+
+void test_smaller_budget_splits_again_under_a_new_sequence()
+{
+    Fragmenter frag;
+    frag.load(message, 40, 22);
+    uint8_t frame[22];
+    frag.next(frame);
+    uint8_t seq = frame[0];
+    frag.commit();
+
+    TEST_ASSERT_TRUE(frag.fit(12));
+    TEST_ASSERT_EQUAL(0, frag.fragmentIndex());
+    TEST_ASSERT_EQUAL(4, frag.fragmentCount());
+    TEST_ASSERT_EQUAL(12, frag.next(frame));
+    TEST_ASSERT_EQUAL((uint8_t)(seq + 1), frame[0]);
+
+    uint8_t out[Fragmenter::MAX_MESSAGE];
+    TEST_ASSERT_EQUAL(40, reassemble(frag, out));
+    TEST_ASSERT_EQUAL_MEMORY(message, out, 40);
+}
+
+void test_message_waits_when_it_cannot_be_split_again()
+{
+    Fragmenter frag;
+    frag.load(message, 40, 22);
+    uint8_t frame[22];
+    frag.next(frame);
+    uint8_t seq = frame[0];
+    frag.commit();
+
+    // 40 bytes in 1 byte fragments is more than MAX_FRAGMENTS
+    TEST_ASSERT_FALSE(frag.fit(Fragmenter::HEADER_LEN + 1));
+    TEST_ASSERT_TRUE(frag.pending());
+    TEST_ASSERT_EQUAL(1, frag.fragmentIndex());
+    TEST_ASSERT_EQUAL(2, frag.fragmentCount());
+
+    // Once the data rate is back the message carries on where it was
+    TEST_ASSERT_TRUE(frag.fit(22));
+    frag.next(frame);
+    TEST_ASSERT_EQUAL(seq, frame[0]);
+    TEST_ASSERT_EQUAL(0x11, frame[1]);
+    TEST_ASSERT_EQUAL_MEMORY(message + 20, frame + Fragmenter::HEADER_LEN, 20);
+}
+
+void test_clear_abandons_the_message()
+{
+    Fragmenter frag;
+    frag.load(message, 40, 12);
+    TEST_ASSERT_TRUE(frag.pending());
+    frag.clear();
+    TEST_ASSERT_FALSE(frag.pending());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_message_splits_into_fragments_that_reassemble);
+    RUN_TEST(test_message_needing_too_many_fragments_is_refused);
+    RUN_TEST(test_fit_keeps_the_position_when_the_budget_allows);
+    RUN_TEST(test_smaller_budget_splits_again_under_a_new_sequence);
+    RUN_TEST(test_message_waits_when_it_cannot_be_split_again);
+    RUN_TEST(test_clear_abandons_the_message);
+    return UNITY_END();
+}
@@ -0,0 +1,220 @@
+#include <unity.h>
+#include <Journal.hpp>
+
+static const uint8_t CONFIG[] = {2, 0x58, 0x02, 0x20, 0x1C, 0, 2, 0x3C, 0x00, 1};
+static uint8_t schedules[75];
+static uint8_t session[60];
+
+// Journal with config, schedules and session written, as after a join
+static void writeBase()
+{
+    Journal journal;
+    journal.begin();
+    journal.append(JOURNAL_CONFIG, CONFIG, sizeof(CONFIG));
+    journal.append(JOURNAL_SCHEDULE, schedules, sizeof(schedules));
+    journal.append(JOURNAL_SESSION, session, sizeof(session));
+}
+
+static void assertBaseHeld(const Journal &journal)
+{
+    uint8_t buf[Journal::MAX_LEN];
+    uint8_t len;
+    TEST_ASSERT_TRUE(journal.load(JOURNAL_CONFIG, buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(sizeof(CONFIG), len);
+    TEST_ASSERT_EQUAL_MEMORY(CONFIG, buf, len);
+    TEST_ASSERT_TRUE(journal.load(JOURNAL_SCHEDULE, buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(sizeof(schedules), len);
+    TEST_ASSERT_EQUAL_MEMORY(schedules, buf, len);
+    TEST_ASSERT_TRUE(journal.load(JOURNAL_SESSION, buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(sizeof(session), len);
+    TEST_ASSERT_EQUAL_MEMORY(session, buf, len);
+}
+
+static uint32_t loadCounter(const Journal &journal)
+{
+    uint32_t counter[3];
+    uint8_t len;
+    TEST_ASSERT_TRUE(journal.load(JOURNAL_FCNT, counter, sizeof(counter), len));
+    TEST_ASSERT_EQUAL(sizeof(counter), len);
+    return counter[1];
+}
+
+static void appendCounter(Journal &journal, uint32_t n)
+{
+    uint32_t counter[3] = {0x26011234, n, n / 2};
+    journal.append(JOURNAL_FCNT, counter, sizeof(counter));
+}
+
+void setUp()
+{
+    FlashClass::reset();
+    for (uint8_t i = 0; i < sizeof(schedules); ++i)
+    {
+        schedules[i] = i;
+    }
+    memset(session, 0x5A, sizeof(session));
+}
+
+void tearDown()
+{
+}
+
+void test_blank_flash_is_an_empty_journal()
+{
+    Journal journal;
+    journal.begin();
+    TEST_ASSERT_TRUE(journal.empty());
+    uint8_t buf[Journal::MAX_LEN];
+    uint8_t len;
+    TEST_ASSERT_FALSE(journal.load(JOURNAL_CONFIG, buf, sizeof(buf), len));
+}
+
+void test_records_are_replayed_at_boot()
+{
+    writeBase();
+    Journal journal;
+    journal.begin();
+    TEST_ASSERT_FALSE(journal.empty());
+    assertBaseHeld(journal);
+
+    // The latest record of a type wins
+    appendCounter(journal, 1);
+    appendCounter(journal, 2);
+    Journal again;
+    again.begin();
+    TEST_ASSERT_EQUAL_UINT32(2, loadCounter(again));
+}
+
+void test_bad_records_are_refused()
+{
+    Journal journal;
+    journal.begin();
+    uint8_t buf[Journal::MAX_LEN + 1] = {};
+    TEST_ASSERT_FALSE(journal.append(JOURNAL_CONFIG, buf, sizeof(buf)));
+    TEST_ASSERT_FALSE(journal.append(0, buf, 1));
+    TEST_ASSERT_FALSE(journal.append(JOURNAL_TYPES, buf, 1));
+    TEST_ASSERT_TRUE(journal.empty());
+}
+
+void test_record_longer_than_the_buffer_is_not_loaded()
+{
+    writeBase();
+    Journal journal;
+    journal.begin();
+
+    // The schedules are 75 bytes, a copy into buf would overrun it (the sanitizer sees it)
+    uint8_t buf[sizeof(CONFIG)];
+    uint8_t len = 0;
+    TEST_ASSERT_FALSE(journal.load(JOURNAL_SCHEDULE, buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(0, len);
+    TEST_ASSERT_TRUE(journal.load(JOURNAL_CONFIG, buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(sizeof(CONFIG), len);
+}
+
+void test_unchanged_update_writes_nothing()
+{
+    writeBase();
+    Journal journal;
+    journal.begin();
+    uint32_t erases = FlashClass::eraseCount();
+    for (uint16_t i = 0; i < 1000; ++i)
+    {
+        TEST_ASSERT_TRUE(journal.update(JOURNAL_CONFIG, CONFIG, sizeof(CONFIG)));
+    }
+    TEST_ASSERT_EQUAL_UINT32(erases, FlashClass::eraseCount());
+}
+
+void test_rolling_spreads_erases_and_keeps_every_type()
+{
+    writeBase();
+    Journal journal;
+    journal.begin();
+
+    // 16 byte records: a roll per row of them, less the room taken by the records copied
+    // forward, which is at most the header and a copy of each other type
+    uint32_t erases = FlashClass::eraseCount();
+    for (uint32_t n = 0; n < 5000; ++n)
+    {
+        appendCounter(journal, n);
+    }
+    uint32_t rolls = FlashClass::eraseCount() - erases;
+    TEST_ASSERT_GREATER_OR_EQUAL(5000 * 16 / Journal::ROW_SIZE, rolls);
+    TEST_ASSERT_LESS_OR_EQUAL(5000 * 16 / (Journal::ROW_SIZE - 8 - 3 * 84) + 1, rolls);
+
+    Journal again;
+    again.begin();
+    assertBaseHeld(again);
+    TEST_ASSERT_EQUAL_UINT32(4999, loadCounter(again));
+}
+
+void test_torn_record_leaves_the_previous_one()
+{
+    writeBase();
+    {
+        Journal journal;
+        journal.begin();
+        appendCounter(journal, 100);
+
+        // Power lost part way through the next record
+        FlashClass::writeBudget() = 7;
+        appendCounter(journal, 101);
+        FlashClass::writeBudget() = LONG_MAX;
+    }
+
+    Journal journal;
+    journal.begin();
+    TEST_ASSERT_EQUAL_UINT32(100, loadCounter(journal));
+    assertBaseHeld(journal);
+
+    // And the row carries on after it
+    appendCounter(journal, 102);
+    Journal again;
+    again.begin();
+    TEST_ASSERT_EQUAL_UINT32(102, loadCounter(again));
+}
+
+void test_power_loss_anywhere_in_a_roll_loses_nothing_older()
+{
+    writeBase();
+    uint32_t last = 0;
+    for (uint16_t cut = 0; cut < 1200; cut += 7)
+    {
+        {
+            Journal journal;
+            journal.begin();
+            for (uint8_t i = 0; i < 4; ++i)
+            {
+                appendCounter(journal, ++last);
+            }
+
+            // Enough appends to roll at least once, cut short after cut bytes
+            FlashClass::writeBudget() = cut;
+            for (uint8_t i = 0; i < 70; ++i)
+            {
+                appendCounter(journal, last + 1 + i);
+            }
+            FlashClass::writeBudget() = LONG_MAX;
+        }
+
+        Journal journal;
+        journal.begin();
+        assertBaseHeld(journal);
+        uint32_t counter = loadCounter(journal);
+        TEST_ASSERT_GREATER_OR_EQUAL(last, counter);
+        last = counter;
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_blank_flash_is_an_empty_journal);
+    RUN_TEST(test_records_are_replayed_at_boot);
+    RUN_TEST(test_bad_records_are_refused);
+    RUN_TEST(test_record_longer_than_the_buffer_is_not_loaded);
+    RUN_TEST(test_unchanged_update_writes_nothing);
+    RUN_TEST(test_rolling_spreads_erases_and_keeps_every_type);
+    RUN_TEST(test_torn_record_leaves_the_previous_one);
+    RUN_TEST(test_power_loss_anywhere_in_a_roll_loses_nothing_older);
+    return UNITY_END();
+}
@@ -0,0 +1,85 @@
+#include <unity.h>
+#include <LinkQuality.hpp>
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_first_sample_sets_the_averages()
+{
+    LinkQuality lq;
+    TEST_ASSERT_FALSE(lq.valid());
+    lq.sample(-97, -22);
+    TEST_ASSERT_TRUE(lq.valid());
+    TEST_ASSERT_EQUAL_INT16(-97, lq.rssi());
+    TEST_ASSERT_EQUAL_INT8(-22, lq.snr());
+}
+
+void test_averages_follow_a_change_gradually()
+{
+    LinkQuality lq;
+    lq.sample(-120, -40);
+    lq.sample(-80, 40);
+    TEST_ASSERT_EQUAL_INT16(-115, lq.rssi());
+    TEST_ASSERT_EQUAL_INT8(-30, lq.snr());
+
+    for (uint8_t i = 0; i < 60; ++i)
+    {
+        lq.sample(-80, 40);
+    }
+    TEST_ASSERT_UINT32_WITHIN(1, 80, -lq.rssi());
+    TEST_ASSERT_UINT32_WITHIN(1, 40, lq.snr());
+}
+
+void test_data_rate_keeps_the_snr_margin()
+{
+    LinkQuality lq;
+    TEST_ASSERT_EQUAL(0, lq.chooseDr());
+
+    // DR3 (SF7) demodulates down to -7.5 dB, each slower rate 2.5 dB lower
+    LinkQuality good;
+    good.sample(-90, 10 * 4);
+    TEST_ASSERT_EQUAL(3, good.chooseDr());
+
+    LinkQuality fair;
+    fair.sample(-110, 0);
+    TEST_ASSERT_EQUAL(2, fair.chooseDr());
+
+    LinkQuality poor;
+    poor.sample(-120, -10 * 4);
+    TEST_ASSERT_EQUAL(0, poor.chooseDr());
+}
+
+void test_lost_acks_step_the_data_rate_down()
+{
+    LinkQuality lq;
+    lq.sample(-90, 40);
+    lq.ackResult(false);
+    TEST_ASSERT_EQUAL(12, lq.lossPercent());
+    TEST_ASSERT_EQUAL(3, lq.chooseDr());
+
+    lq.ackResult(false);
+    TEST_ASSERT_EQUAL(23, lq.lossPercent());
+    TEST_ASSERT_EQUAL(2, lq.chooseDr());
+
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        lq.ackResult(true);
+    }
+    TEST_ASSERT_LESS_THAN(LinkQuality::LOSS_STEP_DOWN, lq.lossPercent());
+    TEST_ASSERT_EQUAL(3, lq.chooseDr());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_sets_the_averages);
+    RUN_TEST(test_averages_follow_a_change_gradually);
+    RUN_TEST(test_data_rate_keeps_the_snr_margin);
+    RUN_TEST(test_lost_acks_step_the_data_rate_down);
+    return UNITY_END();
+}
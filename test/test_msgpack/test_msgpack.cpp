@@ -0,0 +1,194 @@
+#include <unity.h>
+#include <MsgPackReader.hpp>
+#include <stdlib.h>
+
+/*
+ * {"a": [1, -1, 200, -200, 70000, nil, true, 1.5, bin[2], ext[1]], "bb": {"c": "xyz"}}
+ * then a trailing 7
+ */
+static const uint8_t DOC[] = {
+    0x82,
+    0xA1, 'a',
+    0x9A, 0x01, 0xFF, 0xCC, 0xC8, 0xD1, 0xFF, 0x38, 0xCE, 0x00, 0x01, 0x11, 0x70, 0xC0, 0xC3,
+    0xCB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xC4, 0x02, 0xAA, 0xBB,
+    0xD4, 0x01, 0x55,
+    0xA2, 'b', 'b',
+    0x81, 0xA1, 'c', 0xA3, 'x', 'y', 'z',
+    0x07};
+
+static const size_t DOC_END = sizeof(DOC) - 1; // Length of the map, without the trailing value
+
+// The reader gets a heap copy of exactly len bytes, so a sanitizer sees any over-read
+static uint8_t *copy(const uint8_t *data, size_t len)
+{
+    uint8_t *buf = (uint8_t *)malloc(len ? len : 1);
+    memcpy(buf, data, len);
+    return buf;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_integers_decode_in_every_width()
+{
+    MsgPackReader r(DOC + 3, DOC_END - 3);
+    uint32_t n;
+    TEST_ASSERT_TRUE(r.readArray(n));
+    TEST_ASSERT_EQUAL(10, n);
+
+    int32_t v;
+    TEST_ASSERT_TRUE(r.readInt(v));
+    TEST_ASSERT_EQUAL_INT32(1, v);
+    TEST_ASSERT_TRUE(r.readInt(v));
+    TEST_ASSERT_EQUAL_INT32(-1, v);
+    TEST_ASSERT_TRUE(r.readInt(v));
+    TEST_ASSERT_EQUAL_INT32(200, v);
+    TEST_ASSERT_TRUE(r.readInt(v));
+    TEST_ASSERT_EQUAL_INT32(-200, v);
+    uint32_t u;
+    TEST_ASSERT_TRUE(r.readUint(u));
+    TEST_ASSERT_EQUAL_UINT32(70000, u);
+    TEST_ASSERT_EQUAL(MsgPackReader::NIL, r.peek());
+    TEST_ASSERT_TRUE(r.ok());
+}
+
+void test_uint32_above_int32_only_reads_unsigned()
+{
+    const uint8_t big[] = {0xCE, 0x80, 0x00, 0x00, 0x00};
+    MsgPackReader asUint(big, sizeof(big));
+    uint32_t u;
+    TEST_ASSERT_TRUE(asUint.readUint(u));
+    TEST_ASSERT_EQUAL_HEX32(0x80000000UL, u);
+
+    MsgPackReader asInt(big, sizeof(big));
+    int32_t v;
+    TEST_ASSERT_FALSE(asInt.readInt(v));
+    TEST_ASSERT_FALSE(asInt.ok());
+
+    const uint8_t negative[] = {0xFF};
+    MsgPackReader neg(negative, sizeof(negative));
+    TEST_ASSERT_FALSE(neg.readUint(u));
+}
+
+void test_strings_point_into_the_buffer()
+{
+    MsgPackReader r(DOC, DOC_END);
+    uint32_t n;
+    r.readMap(n);
+    const char *s;
+    uint32_t len;
+    TEST_ASSERT_TRUE(r.readStr(s, len));
+    TEST_ASSERT_TRUE(s == (const char *)DOC + 2);
+    TEST_ASSERT_TRUE(msgPackStrEquals(s, len, "a"));
+    TEST_ASSERT_FALSE(msgPackStrEquals(s, len, "ab"));
+    TEST_ASSERT_TRUE(msgPackStrEquals("On", 2, "ON", true));
+    TEST_ASSERT_FALSE(msgPackStrEquals("On", 2, "ON"));
+}
+
+void test_skip_steps_over_nested_values_of_every_type()
+{
+    MsgPackReader r(DOC, sizeof(DOC));
+    TEST_ASSERT_TRUE(r.skip());
+    int32_t v;
+    TEST_ASSERT_TRUE(r.readInt(v));
+    TEST_ASSERT_EQUAL_INT32(7, v);
+    TEST_ASSERT_TRUE(r.atEnd());
+
+    // Map members one at a time
+    MsgPackReader m(DOC, DOC_END);
+    uint32_t n;
+    m.readMap(n);
+    TEST_ASSERT_TRUE(m.skip());
+    TEST_ASSERT_TRUE(m.skip());
+    const char *s;
+    uint32_t len;
+    TEST_ASSERT_TRUE(m.readStr(s, len));
+    TEST_ASSERT_TRUE(msgPackStrEquals(s, len, "bb"));
+}
+
+void test_every_truncation_fails_without_reading_past_the_end()
+{
+    for (size_t len = 0; len < DOC_END; ++len)
+    {
+        uint8_t *buf = copy(DOC, len);
+        MsgPackReader r(buf, len);
+        TEST_ASSERT_FALSE(r.skip());
+        TEST_ASSERT_FALSE(r.ok());
+        free(buf);
+    }
+}
+
+void test_errors_stick()
+{
+    MsgPackReader r(DOC, DOC_END);
+    uint32_t n;
+    TEST_ASSERT_FALSE(r.readArray(n));
+    TEST_ASSERT_FALSE(r.ok());
+    TEST_ASSERT_EQUAL(MsgPackReader::INVALID, r.peek());
+    TEST_ASSERT_FALSE(r.readMap(n));
+    TEST_ASSERT_FALSE(r.skip());
+}
+
+void test_counts_larger_than_the_data_are_refused()
+{
+    // 2^31 members would wrap to 0 values when counted as keys and values
+    const uint8_t hugeMap[] = {0xDF, 0x80, 0x00, 0x00, 0x00, 0x01};
+    uint8_t *buf = copy(hugeMap, sizeof(hugeMap));
+    MsgPackReader r(buf, sizeof(hugeMap));
+    TEST_ASSERT_FALSE(r.skip());
+    free(buf);
+
+    const uint8_t hugeStr[] = {0xDB, 0xFF, 0xFF, 0xFF, 0xFF, 'x'};
+    buf = copy(hugeStr, sizeof(hugeStr));
+    MsgPackReader s(buf, sizeof(hugeStr));
+    TEST_ASSERT_FALSE(s.skip());
+    free(buf);
+
+    const uint8_t hugeExt[] = {0xC9, 0xFF, 0xFF, 0xFF, 0xF0, 0x01, 0x00};
+    buf = copy(hugeExt, sizeof(hugeExt));
+    MsgPackReader e(buf, sizeof(hugeExt));
+    TEST_ASSERT_FALSE(e.skip());
+    free(buf);
+}
+
+void test_nesting_deeper_than_the_skip_limit_fails()
+{
+    uint8_t deep[16];
+    memset(deep, 0x91, sizeof(deep));
+    deep[sizeof(deep) - 1] = 0xC0;
+    MsgPackReader r(deep, sizeof(deep));
+    TEST_ASSERT_FALSE(r.skip());
+
+    MsgPackReader shallow(deep + sizeof(deep) - 4, 4);
+    TEST_ASSERT_TRUE(shallow.skip());
+    TEST_ASSERT_TRUE(shallow.atEnd());
+}
+
+void test_unused_type_byte_is_invalid()
+{
+    const uint8_t reserved[] = {0xC1};
+    MsgPackReader r(reserved, sizeof(reserved));
+    TEST_ASSERT_EQUAL(MsgPackReader::INVALID, r.peek());
+    TEST_ASSERT_FALSE(r.skip());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_integers_decode_in_every_width);
+    RUN_TEST(test_uint32_above_int32_only_reads_unsigned);
+    RUN_TEST(test_strings_point_into_the_buffer);
+    RUN_TEST(test_skip_steps_over_nested_values_of_every_type);
+    RUN_TEST(test_every_truncation_fails_without_reading_past_the_end);
+    RUN_TEST(test_errors_stick);
+    RUN_TEST(test_counts_larger_than_the_data_are_refused);
+    RUN_TEST(test_nesting_deeper_than_the_skip_limit_fails);
+    RUN_TEST(test_unused_type_byte_is_invalid);
+    return UNITY_END();
+}
@@ -0,0 +1,102 @@
+#include <unity.h>
+#include <RuntimeConfig.hpp>
+#include <FlashStorage.h>
+
+static const RuntimeConfig DEFAULTS = {300, 3600, true, 1, 0, true, 10, 30};
+
+void setUp()
+{
+    FlashClass::reset();
+}
+
+void tearDown()
+{
+}
+
+void test_config_round_trips_through_the_journal()
+{
+    RuntimeConfig saved = {600, 7200, false, 3, -300, false, 20, 600};
+    {
+        Journal journal;
+        journal.begin();
+        ConfigStore(journal).save(saved);
+    }
+
+    Journal journal;
+    journal.begin();
+    RuntimeConfig loaded = DEFAULTS;
+    TEST_ASSERT_TRUE(ConfigStore(journal).load(loaded));
+    TEST_ASSERT_EQUAL(600, loaded.txInterval);
+    TEST_ASSERT_EQUAL(7200, loaded.statusPeriod);
+    TEST_ASSERT_FALSE(loaded.logging);
+    TEST_ASSERT_EQUAL(3, loaded.subBand);
+    TEST_ASSERT_EQUAL(-300, loaded.tzMinutes);
+    TEST_ASSERT_FALSE(loaded.adr);
+    TEST_ASSERT_EQUAL(20, loaded.airHourSec);
+    TEST_ASSERT_EQUAL(600, loaded.airDaySec);
+}
+
+void test_other_versions_are_ignored()
+{
+    const uint8_t v2[] = {2, 0x58, 0x02, 0x20, 0x1C, 0, 2, 0x3C, 0x00, 1};
+    const uint8_t v4[] = {4, 0x58, 0x02, 0x20, 0x1C, 0, 2, 0x3C, 0x00, 1, 10, 0, 30, 0};
+    Journal journal;
+    journal.begin();
+    RuntimeConfig loaded = DEFAULTS;
+
+    journal.append(JOURNAL_CONFIG, v2, sizeof(v2));
+    TEST_ASSERT_FALSE(ConfigStore(journal).load(loaded));
+    journal.append(JOURNAL_CONFIG, v4, sizeof(v4));
+    TEST_ASSERT_FALSE(ConfigStore(journal).load(loaded));
+    TEST_ASSERT_EQUAL(300, loaded.txInterval);
+}
+
+void test_patch_applies_all_fields_or_none()
+{
+    RuntimeConfig config = DEFAULTS;
+    const uint8_t patch[] = {CFG_TX_INTERVAL, 0x78, 0x00, CFG_ADR, 0};
+    TEST_ASSERT_TRUE(patchConfig(config, patch, sizeof(patch)));
+    TEST_ASSERT_EQUAL(120, config.txInterval);
+    TEST_ASSERT_FALSE(config.adr);
+
+    const uint8_t badSubBand[] = {CFG_TX_INTERVAL, 0x3C, 0x00, CFG_SUB_BAND, 8};
+    TEST_ASSERT_FALSE(patchConfig(config, badSubBand, sizeof(badSubBand)));
+    TEST_ASSERT_EQUAL(120, config.txInterval);
+
+    const uint8_t truncated[] = {CFG_STATUS_PERIOD, 0x10};
+    TEST_ASSERT_FALSE(patchConfig(config, truncated, sizeof(truncated)));
+
+    const uint8_t unknown[] = {0x7F, 0};
+    TEST_ASSERT_FALSE(patchConfig(config, unknown, sizeof(unknown)));
+
+    // The heartbeat cannot come more often than the work interval
+    const uint8_t shortStatus[] = {CFG_STATUS_PERIOD, 0x3C, 0x00};
+    TEST_ASSERT_FALSE(patchConfig(config, shortStatus, sizeof(shortStatus)));
+}
+
+void test_airtime_budget_is_patched_in_seconds()
+{
+    RuntimeConfig config = DEFAULTS;
+    const uint8_t patch[] = {CFG_AIR_HOUR, 0x3C, 0x00, CFG_AIR_DAY, 0x2C, 0x01};
+    TEST_ASSERT_TRUE(patchConfig(config, patch, sizeof(patch)));
+    TEST_ASSERT_EQUAL(60, config.airHourSec);
+    TEST_ASSERT_EQUAL(300, config.airDaySec);
+
+    const uint8_t zero[] = {CFG_AIR_HOUR, 0, 0};
+    TEST_ASSERT_FALSE(patchConfig(config, zero, sizeof(zero)));
+
+    // No more in a day than in its last hour
+    const uint8_t shortDay[] = {CFG_AIR_DAY, 0x3B, 0x00};
+    TEST_ASSERT_FALSE(patchConfig(config, shortDay, sizeof(shortDay)));
+    TEST_ASSERT_EQUAL(300, config.airDaySec);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_config_round_trips_through_the_journal);
+    RUN_TEST(test_other_versions_are_ignored);
+    RUN_TEST(test_patch_applies_all_fields_or_none);
+    RUN_TEST(test_airtime_budget_is_patched_in_seconds);
+    return UNITY_END();
+}
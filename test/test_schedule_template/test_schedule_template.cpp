@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <ScheduleTemplate.hpp>
+
+static const uint8_t MAX_ENTRIES = 25;
+static Schedule entries[MAX_ENTRIES];
+static uint8_t count;
+
+static void assertEntry(uint8_t i, bool state, int dow, int hour, int min)
+{
+    TEST_ASSERT_EQUAL(state, entries[i].powerState);
+    TEST_ASSERT_EQUAL(dow, entries[i].dow);
+    TEST_ASSERT_EQUAL(hour, entries[i].hour);
+    TEST_ASSERT_EQUAL(min, entries[i].min);
+}
+
+void setUp()
+{
+    memset(entries, 0, sizeof(entries));
+    count = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_bad_arguments_are_refused()
+{
+    const uint8_t unknown[] = {99};
+    TEST_ASSERT_EQUAL(TEMPLATE_UNKNOWN, expandTemplate(unknown, sizeof(unknown), entries, MAX_ENTRIES, count));
+
+    const uint8_t badLen[] = {1, 6};
+    TEST_ASSERT_EQUAL(TEMPLATE_BAD_VALUE, expandTemplate(badLen, sizeof(badLen), entries, MAX_ENTRIES, count));
+    const uint8_t badHour[] = {1, 24, 0};
+    TEST_ASSERT_EQUAL(TEMPLATE_BAD_VALUE, expandTemplate(badHour, sizeof(badHour), entries, MAX_ENTRIES, count));
+    const uint8_t badMin[] = {1, 6, 60};
+    TEST_ASSERT_EQUAL(TEMPLATE_BAD_VALUE, expandTemplate(badMin, sizeof(badMin), entries, MAX_ENTRIES, count));
+    const uint8_t noDuration[] = {1, 6, 0, 0};
+    TEST_ASSERT_EQUAL(TEMPLATE_BAD_VALUE, expandTemplate(noDuration, sizeof(noDuration), entries, MAX_ENTRIES, count));
+}
+
+void test_always_off_has_no_entries()
+{
+    const uint8_t off[] = {0};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(off, sizeof(off), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(0, count);
+}
+
+void test_daily_default_is_an_hour_from_six()
+{
+    // The hour ends on the hour, no entry is needed to switch off
+    const uint8_t daily[] = {1};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(daily, sizeof(daily), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(7, count);
+    for (uint8_t dow = 0; dow < 7; ++dow)
+    {
+        assertEntry(dow, true, dow, 6, 0);
+    }
+}
+
+void test_period_has_an_on_entry_in_every_hour_it_covers()
+{
+    const uint8_t weekday[] = {2, 6, 30, 160};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(weekday, sizeof(weekday), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(25, count);
+    assertEntry(0, true, 1, 6, 30);
+    assertEntry(1, true, 1, 7, 0);
+    assertEntry(2, true, 1, 8, 0);
+    assertEntry(3, true, 1, 9, 0);
+    assertEntry(4, false, 1, 9, 10);
+    assertEntry(5, true, 2, 6, 30);
+}
+
+void test_period_past_midnight_runs_into_the_next_day()
+{
+    // Saturday's period ends early on Sunday, at the start of the week
+    const uint8_t weekend[] = {3, 23, 30, 90};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(weekend, sizeof(weekend), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(4, count);
+    assertEntry(0, true, 0, 0, 0);
+    assertEntry(1, true, 0, 23, 30);
+    assertEntry(2, true, 1, 0, 0);
+    assertEntry(3, true, 6, 23, 30);
+
+    // Ending exactly at the end of the week does not wrap
+    const uint8_t late[] = {3, 23, 0, 60};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(late, sizeof(late), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(2, count);
+    assertEntry(0, true, 0, 23, 0);
+    assertEntry(1, true, 6, 23, 0);
+}
+
+void test_overlapping_periods_merge()
+{
+    // 16:00 for an hour runs into the fixed 16:30 period
+    const uint8_t twice[] = {6, 16, 0, 60};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(twice, sizeof(twice), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(15, count);
+    assertEntry(0, true, 1, 16, 0);
+    assertEntry(1, true, 1, 17, 0);
+    assertEntry(2, false, 1, 17, 30);
+}
+
+void test_back_to_back_periods_do_not_switch_off_in_between()
+{
+    const uint8_t twice[] = {6, 15, 30, 60};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(twice, sizeof(twice), entries, MAX_ENTRIES, count));
+    TEST_ASSERT_EQUAL(20, count);
+    assertEntry(0, true, 1, 15, 30);
+    assertEntry(1, true, 1, 16, 0);
+    assertEntry(2, true, 1, 17, 0);
+    assertEntry(3, false, 1, 17, 30);
+}
+
+void test_too_many_entries_for_the_table_is_refused()
+{
+    // Two hours from 06:30 every day is four entries a day
+    const uint8_t daily[] = {1, 6, 30, 120};
+    TEST_ASSERT_EQUAL(TEMPLATE_TOO_LARGE, expandTemplate(daily, sizeof(daily), entries, MAX_ENTRIES, count));
+
+    const uint8_t twice[] = {6, 6, 0, 60};
+    TEST_ASSERT_EQUAL(TEMPLATE_OK, expandTemplate(twice, sizeof(twice), entries, 20, count));
+    TEST_ASSERT_EQUAL(20, count);
+    TEST_ASSERT_EQUAL(TEMPLATE_TOO_LARGE, expandTemplate(twice, sizeof(twice), entries, 19, count));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bad_arguments_are_refused);
+    RUN_TEST(test_always_off_has_no_entries);
+    RUN_TEST(test_daily_default_is_an_hour_from_six);
+    RUN_TEST(test_period_has_an_on_entry_in_every_hour_it_covers);
+    RUN_TEST(test_period_past_midnight_runs_into_the_next_day);
+    RUN_TEST(test_overlapping_periods_merge);
+    RUN_TEST(test_back_to_back_periods_do_not_switch_off_in_between);
+    RUN_TEST(test_too_many_entries_for_the_table_is_refused);
+    return UNITY_END();
+}
@@ -0,0 +1,155 @@
+#include <unity.h>
+#include <TransitionLog.hpp>
+
+static const uint32_t T0 = 1600000040; // 20 s past a minute
+
+static uint16_t deltaAt(const uint8_t *frame, uint8_t entry)
+{
+    const uint8_t *e = frame + TransitionLog::HEADER_LEN + entry * TransitionLog::ENTRY_LEN;
+    return e[0] | (e[1] << 8);
+}
+
+static uint32_t baseOf(const uint8_t *frame)
+{
+    return frame[0] | (frame[1] << 8) | ((uint32_t)frame[2] << 16) | ((uint32_t)frame[3] << 24);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_entries_are_minute_offsets_from_the_base()
+{
+    TransitionLog log;
+    log.record(T0, 0, true);
+    log.record(T0 + 5 * 60, 1, false);
+
+    uint8_t frame[64];
+    uint8_t entries;
+    size_t len = log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL(2, entries);
+    TEST_ASSERT_EQUAL(TransitionLog::HEADER_LEN + 2 * TransitionLog::ENTRY_LEN, len);
+    TEST_ASSERT_EQUAL_UINT32(T0 - 20, baseOf(frame));
+    TEST_ASSERT_EQUAL(0, frame[4]);
+    TEST_ASSERT_EQUAL(0, deltaAt(frame, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x01, frame[7]);
+    TEST_ASSERT_EQUAL(5, deltaAt(frame, 1));
+    TEST_ASSERT_EQUAL_HEX8(0x02, frame[10]);
+}
+
+void test_encode_packs_what_fits_and_commit_rebases()
+{
+    TransitionLog log;
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        log.record(T0 + i * 600, 0, i & 1);
+    }
+
+    uint8_t frame[TransitionLog::HEADER_LEN + 2 * TransitionLog::ENTRY_LEN + 1];
+    uint8_t entries;
+    log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL(2, entries);
+
+    log.commit(entries);
+    TEST_ASSERT_EQUAL(2, log.size());
+    uint8_t rest[64];
+    log.encode(rest, sizeof(rest), entries);
+    TEST_ASSERT_EQUAL(2, entries);
+    TEST_ASSERT_EQUAL_UINT32(T0 - 20 + 1200, baseOf(rest));
+    TEST_ASSERT_EQUAL(0, deltaAt(rest, 0));
+    TEST_ASSERT_EQUAL(10, deltaAt(rest, 1));
+}
+
+void test_clock_stepping_back_moves_the_base_down()
+{
+    TransitionLog log;
+    log.record(T0 + 3600, 0, true);
+    log.record(T0, 0, false);
+
+    uint8_t frame[64];
+    uint8_t entries;
+    log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL(2, entries);
+    TEST_ASSERT_EQUAL_UINT32(T0 - 20, baseOf(frame));
+    TEST_ASSERT_EQUAL(60, deltaAt(frame, 0));
+    TEST_ASSERT_EQUAL(0, deltaAt(frame, 1));
+
+    // The earliest remaining entry becomes the base, not the oldest
+    log.commit(1);
+    log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL_UINT32(T0 - 20, baseOf(frame));
+    TEST_ASSERT_EQUAL(0, deltaAt(frame, 0));
+}
+
+void test_clock_stepping_back_too_far_clamps_to_the_base()
+{
+    TransitionLog log;
+    log.record(T0, 0, true);
+    log.record(T0 + 0xFFF0UL * 60, 0, false);
+    log.record(T0 - 3600, 1, true);
+
+    uint8_t frame[64];
+    uint8_t entries;
+    log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL(3, entries);
+    TEST_ASSERT_EQUAL_UINT32(T0 - 20, baseOf(frame));
+    TEST_ASSERT_EQUAL(0xFFF0, deltaAt(frame, 1));
+    TEST_ASSERT_EQUAL(0, deltaAt(frame, 2));
+}
+
+void test_full_log_drops_the_oldest_and_counts_it()
+{
+    TransitionLog log;
+    for (uint8_t i = 0; i <= TransitionLog::CAPACITY; ++i)
+    {
+        log.record(T0 + i * 60, 0, i & 1);
+    }
+    TEST_ASSERT_EQUAL(TransitionLog::CAPACITY, log.size());
+
+    uint8_t frame[TransitionLog::HEADER_LEN + TransitionLog::CAPACITY * TransitionLog::ENTRY_LEN];
+    uint8_t entries;
+    log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL(1, frame[4]);
+    TEST_ASSERT_EQUAL_UINT32(T0 - 20 + 60, baseOf(frame));
+
+    // The drop count goes out once
+    log.commit(1);
+    log.encode(frame, sizeof(frame), entries);
+    TEST_ASSERT_EQUAL(0, frame[4]);
+}
+
+void test_flush_is_pending_on_request_or_at_the_flush_level()
+{
+    TransitionLog log;
+    log.requestFlush();
+    TEST_ASSERT_FALSE(log.flushPending());
+
+    log.record(T0, 0, true);
+    TEST_ASSERT_TRUE(log.flushPending());
+    log.commit(1);
+    TEST_ASSERT_FALSE(log.flushPending());
+
+    for (uint8_t i = 0; i < TransitionLog::FLUSH_LEVEL - 1; ++i)
+    {
+        log.record(T0 + i * 60, 0, true);
+    }
+    TEST_ASSERT_FALSE(log.flushPending());
+    log.record(T0 + 3600, 0, false);
+    TEST_ASSERT_TRUE(log.flushPending());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_are_minute_offsets_from_the_base);
+    RUN_TEST(test_encode_packs_what_fits_and_commit_rebases);
+    RUN_TEST(test_clock_stepping_back_moves_the_base_down);
+    RUN_TEST(test_clock_stepping_back_too_far_clamps_to_the_base);
+    RUN_TEST(test_full_log_drops_the_oldest_and_counts_it);
+    RUN_TEST(test_flush_is_pending_on_request_or_at_the_flush_level);
+    return UNITY_END();
+}
@@ -0,0 +1,54 @@
+#include <unity.h>
+#include <UplinkSlot.hpp>
+
+static const uint8_t EUI[] = {0x00, 0x04, 0xA3, 0x0B, 0x00, 0x1E, 0x5C, 0x7F};
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_slot_is_the_fnv1a_hash_of_the_eui()
+{
+    // FNV-1a of the EUI is 0x99C9B8D8
+    TEST_ASSERT_EQUAL_UINT16(0x99C9B8D8UL % 900, uplinkSlot(EUI, sizeof(EUI), 900));
+    TEST_ASSERT_EQUAL_UINT16(0x99C9B8D8UL % 3600, uplinkSlot(EUI, sizeof(EUI), 3600));
+
+    // Nodes one byte apart land elsewhere
+    uint8_t other[sizeof(EUI)];
+    memcpy(other, EUI, sizeof(EUI));
+    other[7] ^= 1;
+    TEST_ASSERT_TRUE(uplinkSlot(other, sizeof(other), 3600) != uplinkSlot(EUI, sizeof(EUI), 3600));
+}
+
+void test_seconds_to_slot_is_never_zero()
+{
+    const uint32_t start = 1599998400; // On an hour boundary
+    TEST_ASSERT_EQUAL_UINT32(300, secondsToSlot(start + 25, 25, 300));
+    TEST_ASSERT_EQUAL_UINT32(1, secondsToSlot(start + 24, 25, 300));
+    TEST_ASSERT_EQUAL_UINT32(299, secondsToSlot(start + 26, 25, 300));
+
+    // A slot beyond the interval wraps into it
+    TEST_ASSERT_EQUAL_UINT32(300, secondsToSlot(start + 25, 625, 300));
+}
+
+void test_period_changes_at_the_slot()
+{
+    const uint32_t start = 1599998400;
+    uint32_t before = slotPeriod(start + 99, 100, 3600);
+    TEST_ASSERT_EQUAL_UINT32(before + 1, slotPeriod(start + 100, 100, 3600));
+    TEST_ASSERT_EQUAL_UINT32(before + 1, slotPeriod(start + 3699, 100, 3600));
+    TEST_ASSERT_EQUAL_UINT32(before + 2, slotPeriod(start + 3700, 100, 3600));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_slot_is_the_fnv1a_hash_of_the_eui);
+    RUN_TEST(test_seconds_to_slot_is_never_zero);
+    RUN_TEST(test_period_changes_at_the_slot);
+    return UNITY_END();
+}
@@ -0,0 +1,101 @@
+#include <unity.h>
+#include <WarmStore.hpp>
+
+struct State
+{
+    uint32_t epoch;
+    uint8_t relays[2];
+    uint16_t count;
+};
+
+static const State SAVED = {1600000000, {1, 0}, 42};
+static const uint16_t LAYOUT = 0x1234;
+
+void setUp()
+{
+    WarmStore(LAYOUT).clear();
+}
+
+void tearDown()
+{
+}
+
+void test_saved_state_loads_back()
+{
+    WarmStore store(LAYOUT);
+    store.save(&SAVED, sizeof(SAVED));
+
+    State loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    TEST_ASSERT_TRUE(store.load(&loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_MEMORY(&SAVED, &loaded, sizeof(loaded));
+}
+
+void test_nothing_to_load_after_clear_or_with_another_layout()
+{
+    WarmStore store(LAYOUT);
+    State loaded;
+    TEST_ASSERT_FALSE(store.load(&loaded, sizeof(loaded)));
+
+    store.save(&SAVED, sizeof(SAVED));
+    TEST_ASSERT_FALSE(store.load(&loaded, sizeof(loaded) - 1));
+    store.clear();
+    TEST_ASSERT_FALSE(store.load(&loaded, sizeof(loaded)));
+
+    uint8_t tooLarge[WarmStore::CAPACITY + 1] = {};
+    store.save(tooLarge, sizeof(tooLarge));
+    TEST_ASSERT_FALSE(store.load(tooLarge, sizeof(tooLarge)));
+}
+
+void test_state_saved_by_other_firmware_is_not_loaded()
+{
+    WarmStore(LAYOUT + 1).save(&SAVED, sizeof(SAVED));
+
+    WarmStore store(LAYOUT);
+    State loaded;
+    TEST_ASSERT_FALSE(store.load(&loaded, sizeof(loaded)));
+}
+
+void test_state_is_dropped_after_repeated_restarts()
+{
+    WarmStore store(LAYOUT);
+    store.save(&SAVED, sizeof(SAVED));
+
+    // Each load is a warm restart, saving again does not reset the count
+    State loaded;
+    for (uint8_t i = 0; i < WarmStore::MAX_RESTARTS; ++i)
+    {
+        TEST_ASSERT_TRUE(store.load(&loaded, sizeof(loaded)));
+        store.save(&SAVED, sizeof(SAVED));
+    }
+    TEST_ASSERT_FALSE(store.load(&loaded, sizeof(loaded)));
+
+    // After a cold start the count begins again
+    store.clear();
+    store.save(&SAVED, sizeof(SAVED));
+    TEST_ASSERT_TRUE(store.load(&loaded, sizeof(loaded)));
+}
+
+void test_settled_node_restarts_warm_again()
+{
+    WarmStore store(LAYOUT);
+    store.save(&SAVED, sizeof(SAVED));
+
+    State loaded;
+    for (uint8_t i = 0; i < 2 * WarmStore::MAX_RESTARTS; ++i)
+    {
+        TEST_ASSERT_TRUE(store.load(&loaded, sizeof(loaded)));
+        store.settled();
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_saved_state_loads_back);
+    RUN_TEST(test_nothing_to_load_after_clear_or_with_another_layout);
+    RUN_TEST(test_state_saved_by_other_firmware_is_not_loaded);
+    RUN_TEST(test_state_is_dropped_after_repeated_restarts);
+    RUN_TEST(test_settled_node_restarts_warm_again);
+    return UNITY_END();
+}